@@ -119,6 +119,47 @@ RangeVector calculateChangedRanges(
 /// \param[in] Rewrites Rewriter containing written files to write to disk.
 bool writeFiles(const clang::Rewriter &Rewrites);
 
+/// \brief Apply the Replacements of each file in \c GroupedReplacements,
+/// reformat the changed code if requested and write the new contents to disk.
+///
+/// A file whose replacements or reformatting fail to apply is reported and left
+/// unchanged; the other files are still rewritten.
+///
+/// \param[in] GroupedReplacements Deduplicated and conflict free Replacements
+/// to apply, as produced by mergeAndDeduplicate().
+/// \param[in] FormatStyle Style to reformat changed code with, or null to not
+/// reformat.
+/// \param[in] Diagnostics DiagnosticsEngine used for error output.
+///
+/// \returns \li true If all files were rewritten successfully.
+///          \li false If at least one file could not be rewritten.
+bool rewriteFiles(const FileToReplacementsMap &GroupedReplacements,
+                  const format::FormatStyle *FormatStyle,
+                  clang::DiagnosticsEngine &Diagnostics);
+
+/// \brief Apply the Replacements of each file in \c GroupedReplacements and
+/// reformat the changed code if requested, keeping the new contents in memory.
+///
+/// A file already in \c FileContents is rewritten from the contents stored
+/// there rather than from disk, so that the changes of several runs can be
+/// stacked before any file is written. A file whose replacements or
+/// reformatting fail to apply is reported and left as it was.
+///
+/// \param[in] GroupedReplacements Deduplicated and conflict free Replacements
+/// to apply, as produced by mergeAndDeduplicate().
+/// \param[in] FormatStyle Style to reformat changed code with, or null to not
+/// reformat.
+/// \param[in] Diagnostics DiagnosticsEngine used for error output.
+/// \param[in,out] FileContents Contents of files, by file name. The new
+/// contents of the rewritten files are stored there.
+///
+/// \returns \li true If all files were rewritten successfully.
+///          \li false If at least one file could not be rewritten.
+bool rewriteFileContents(const FileToReplacementsMap &GroupedReplacements,
+                         const format::FormatStyle *FormatStyle,
+                         clang::DiagnosticsEngine &Diagnostics,
+                         llvm::StringMap<std::string> &FileContents);
+
 /// \brief Delete the replacement files.
 ///
 /// \param[in] Files Replacement files to delete.
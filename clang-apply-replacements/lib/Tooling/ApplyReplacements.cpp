@@ -258,6 +258,190 @@ bool writeFiles(const clang::Rewriter &Rewrites) {
   return true;
 }
 
+/// \brief Convenience function to get rewritten content for \c Filename from
+/// \c Rewrites.
+///
+/// \pre Replacements[i].getFilePath() == Replacements[i+1].getFilePath().
+/// \post Replacements.empty() -> Result.empty()
+///
+/// \param[in] Replacements Replacements to apply
+/// \param[in] Rewrites Rewriter to use to apply replacements.
+/// \param[out] Result Contents of the file after applying replacements if
+/// replacements were provided.
+///
+/// \returns \li true if all replacements were applied successfully.
+///          \li false if at least one replacement failed to apply.
+static bool
+getRewrittenData(const std::vector<tooling::Replacement> &Replacements,
+                 Rewriter &Rewrites, std::string &Result) {
+  if (Replacements.empty()) return true;
+
+  if (!tooling::applyAllReplacements(Replacements, Rewrites))
+    return false;
+
+  SourceManager &SM = Rewrites.getSourceMgr();
+  FileManager &Files = SM.getFileManager();
+
+  StringRef FileName = Replacements.begin()->getFilePath();
+  const clang::FileEntry *Entry = Files.getFile(FileName);
+  assert(Entry && "Expected an existing file");
+  FileID ID = SM.translateFile(Entry);
+  assert(!ID.isInvalid() && "Expected a valid FileID");
+  const RewriteBuffer *Buffer = Rewrites.getRewriteBufferFor(ID);
+  Result = std::string(Buffer->begin(), Buffer->end());
+
+  return true;
+}
+
+/// \brief Apply \c Replacements and return the new file contents.
+///
+/// \pre Replacements[i].getFilePath() == Replacements[i+1].getFilePath().
+/// \post Replacements.empty() -> Result.empty()
+///
+/// \param[in] Replacements Replacements to apply.
+/// \param[in] FileContents Contents to use instead of those on disk, by file
+/// name.
+/// \param[out] Result Contents of the file after applying replacements if
+/// replacements were provided.
+/// \param[in] Diagnostics For diagnostic output.
+///
+/// \returns \li true if all replacements applied successfully.
+///          \li false if at least one replacement failed to apply.
+static bool
+applyFileReplacements(const std::vector<tooling::Replacement> &Replacements,
+                      const llvm::StringMap<std::string> &FileContents,
+                      std::string &Result, DiagnosticsEngine &Diagnostics) {
+  FileManager Files((FileSystemOptions()));
+  SourceManager SM(Diagnostics, Files);
+  Rewriter Rewrites(SM, LangOptions());
+
+  if (!Replacements.empty()) {
+    StringRef FileName = Replacements.begin()->getFilePath();
+    llvm::StringMap<std::string>::const_iterator Contents =
+        FileContents.find(FileName);
+    const FileEntry *Entry = Files.getFile(FileName);
+    if (Contents != FileContents.end() && Entry)
+      SM.overrideFileContents(
+          Entry, llvm::MemoryBuffer::getMemBufferCopy(Contents->getValue(),
+                                                      FileName));
+  }
+
+  return getRewrittenData(Replacements, Rewrites, Result);
+}
+
+/// \brief Apply code formatting to all places where replacements were made.
+///
+/// \pre !Replacements.empty().
+/// \pre Replacements[i].getFilePath() == Replacements[i+1].getFilePath().
+/// \pre Replacements[i].getOffset() <= Replacements[i+1].getOffset().
+///
+/// \param[in] Replacements Replacements that were made to the file. Provided
+/// to indicate where changes were made.
+/// \param[in] FileData The contents of the file \b after \c Replacements have
+/// been applied.
+/// \param[out] FormattedFileData The contents of the file after reformatting.
+/// \param[in] FormatStyle Style to apply.
+/// \param[in] Diagnostics For diagnostic output.
+///
+/// \returns \li true if reformatting replacements were all successfully
+///          applied.
+///          \li false if at least one reformatting replacement failed to apply.
+static bool
+applyFormatting(const std::vector<tooling::Replacement> &Replacements,
+                const StringRef FileData, std::string &FormattedFileData,
+                const format::FormatStyle &FormatStyle,
+                DiagnosticsEngine &Diagnostics) {
+  assert(!Replacements.empty() && "Need at least one replacement");
+
+  RangeVector Ranges = calculateChangedRanges(Replacements);
+
+  StringRef FileName = Replacements.begin()->getFilePath();
+  tooling::Replacements R =
+      format::reformat(FormatStyle, FileData, Ranges, FileName);
+
+  // FIXME: Remove this copy when tooling::Replacements is implemented as a
+  // vector instead of a set.
+  std::vector<tooling::Replacement> FormattingReplacements;
+  std::copy(R.begin(), R.end(), back_inserter(FormattingReplacements));
+
+  if (FormattingReplacements.empty()) {
+    FormattedFileData = FileData;
+    return true;
+  }
+
+  FileManager Files((FileSystemOptions()));
+  SourceManager SM(Diagnostics, Files);
+  SM.overrideFileContents(Files.getFile(FileName),
+                          llvm::MemoryBuffer::getMemBufferCopy(FileData));
+  Rewriter Rewrites(SM, LangOptions());
+
+  return getRewrittenData(FormattingReplacements, Rewrites, FormattedFileData);
+}
+
+bool rewriteFileContents(const FileToReplacementsMap &GroupedReplacements,
+                         const format::FormatStyle *FormatStyle,
+                         DiagnosticsEngine &Diagnostics,
+                         llvm::StringMap<std::string> &FileContents) {
+  bool Success = true;
+  for (FileToReplacementsMap::const_iterator I = GroupedReplacements.begin(),
+                                             E = GroupedReplacements.end();
+       I != E; ++I) {
+
+    std::string NewFileData;
+
+    // This shouldn't happen but if a file somehow has no replacements skip to
+    // next file.
+    if (I->getValue().empty())
+      continue;
+
+    if (!applyFileReplacements(I->getValue(), FileContents, NewFileData,
+                               Diagnostics)) {
+      errs() << "Failed to apply replacements to " << I->getKey() << "\n";
+      Success = false;
+      continue;
+    }
+
+    // Apply formatting if requested.
+    if (FormatStyle && !applyFormatting(I->getValue(), NewFileData,
+                                        NewFileData, *FormatStyle,
+                                        Diagnostics)) {
+      errs() << "Failed to apply reformatting replacements for " << I->getKey()
+             << "\n";
+      Success = false;
+      continue;
+    }
+
+    FileContents[I->getKey()].swap(NewFileData);
+  }
+
+  return Success;
+}
+
+bool rewriteFiles(const FileToReplacementsMap &GroupedReplacements,
+                  const format::FormatStyle *FormatStyle,
+                  DiagnosticsEngine &Diagnostics) {
+  llvm::StringMap<std::string> FileContents;
+  bool Success = rewriteFileContents(GroupedReplacements, FormatStyle,
+                                     Diagnostics, FileContents);
+
+  for (llvm::StringMap<std::string>::const_iterator I = FileContents.begin(),
+                                                    E = FileContents.end();
+       I != E; ++I) {
+    // Write new file to disk
+    std::string ErrorInfo;
+    llvm::raw_fd_ostream FileStream(I->getKey().str().c_str(), ErrorInfo);
+    if (!ErrorInfo.empty()) {
+      llvm::errs() << "Could not open " << I->getKey() << " for writing\n";
+      Success = false;
+      continue;
+    }
+
+    FileStream << I->getValue();
+  }
+
+  return Success;
+}
+
 bool deleteReplacementFiles(const TUReplacementFiles &Files,
                             clang::DiagnosticsEngine &Diagnostics) {
   bool Success = true;
@@ -29,34 +29,43 @@ static cl::opt<bool> DetectMacros(
     cl::desc("Detect and use macros that expand to the 'override' keyword."),
     cl::cat(TransformsOptionsCategory));
 
+AddOverrideTransform::~AddOverrideTransform() {}
+
 int AddOverrideTransform::apply(const CompilationDatabase &Database,
                                 const std::vector<std::string> &SourcePaths) {
   ClangTool AddOverrideTool(Database, SourcePaths);
-  unsigned AcceptedChanges = 0;
+  Reset();
   MatchFinder Finder;
-  AddOverrideFixer Fixer(AcceptedChanges, DetectMacros,
-                         /*Owner=*/ *this);
-  Finder.addMatcher(makeCandidateForOverrideAttrMatcher(), &Fixer);
-
-  // Make Fixer available to handleBeginSource().
-  this->Fixer = &Fixer;
+  registerMatchers(Finder);
 
   if (int result = AddOverrideTool.run(createActionFactory(Finder))) {
     llvm::errs() << "Error encountered during translation.\n";
     return result;
   }
 
-  setAcceptedChanges(AcceptedChanges);
   return 0;
 }
 
+bool AddOverrideTransform::registerMatchers(MatchFinder &Finder) {
+  // Fixer is also used by handleBeginSource().
+  Fixer.reset(new AddOverrideFixer(getAcceptedChangesCounter(), DetectMacros,
+                                   /*Owner=*/ *this));
+  Finder.addMatcher(makeCandidateForOverrideAttrMatcher(),
+                    profileCallback(Fixer.get(), "CandidateForOverrideAttr"));
+  return true;
+}
+
 bool AddOverrideTransform::handleBeginSource(clang::CompilerInstance &CI,
                                              llvm::StringRef Filename) {
-  assert(Fixer != NULL && "Fixer must be set");
+  assert(Fixer && "Fixer must be set");
   Fixer->setPreprocessor(CI.getPreprocessor());
   return Transform::handleBeginSource(CI, Filename);
 }
 
+std::string AddOverrideTransform::describeOptions() const {
+  return DetectMacros ? "override-macros" : "";
+}
+
 struct AddOverrideFactory : TransformFactory {
   AddOverrideFactory() {
     // if detecting macros is enabled, do not impose requirements on the
@@ -30,15 +30,24 @@ public:
   AddOverrideTransform(const TransformOptions &Options)
       : Transform("AddOverride", Options) {}
 
+  virtual ~AddOverrideTransform();
+
   /// \see Transform::run().
   virtual int apply(const clang::tooling::CompilationDatabase &Database,
                     const std::vector<std::string> &SourcePaths) LLVM_OVERRIDE;
 
+  /// \see Transform::registerMatchers().
+  virtual bool registerMatchers(clang::ast_matchers::MatchFinder &Finder)
+      LLVM_OVERRIDE;
+
   virtual bool handleBeginSource(clang::CompilerInstance &CI,
                                  llvm::StringRef Filename) LLVM_OVERRIDE;
 
+  /// \see Transform::describeOptions().
+  virtual std::string describeOptions() const LLVM_OVERRIDE;
+
 private:
-  AddOverrideFixer *Fixer;
+  llvm::OwningPtr<AddOverrideFixer> Fixer;
 };
 
 #endif // CLANG_MODERNIZE_ADD_OVERRIDE_H
@@ -0,0 +1,319 @@
+//===-- Core/CombinedTransforms.cpp - Single-parse runner -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the definition of the CombinedTransforms class
+/// which runs several transforms on a single parse of each translation unit.
+///
+//===----------------------------------------------------------------------===//
+
+#include "Core/CombinedTransforms.h"
+#include "Core/FileOverlay.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringMap.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+
+namespace {
+
+/// \brief ASTConsumer running the shared matchers and telling
+/// CombinedTransforms when they start and stop.
+class CombinedMatchingConsumer : public ASTConsumer {
+public:
+  CombinedMatchingConsumer(MatchFinder &Finder, CombinedTransforms &Owner)
+      : Finder(Finder), Owner(Owner) {}
+
+  virtual void HandleTranslationUnit(ASTContext &Context) LLVM_OVERRIDE {
+    Owner.handleBeginMatching();
+    Finder.matchAST(Context);
+    Owner.handleEndMatching();
+  }
+
+private:
+  MatchFinder &Finder;
+  CombinedTransforms &Owner;
+};
+
+/// \brief FrontendActionFactory producing FrontendActions that forward
+/// (Begin|End)SourceFileAction calls to CombinedTransforms.
+class CombinedActionFactory : public FrontendActionFactory {
+public:
+  CombinedActionFactory(MatchFinder &Finder, CombinedTransforms &Owner,
+                        const FileOverlay *Overlay)
+      : Finder(Finder), Owner(Owner), Overlay(Overlay) {}
+
+  virtual FrontendAction *create() LLVM_OVERRIDE {
+    return new FactoryAdaptor(Finder, Owner, Overlay);
+  }
+
+private:
+  class FactoryAdaptor : public ASTFrontendAction {
+  public:
+    FactoryAdaptor(MatchFinder &Finder, CombinedTransforms &Owner,
+                   const FileOverlay *Overlay)
+        : Finder(Finder), Owner(Owner), Overlay(Overlay) {}
+
+    ASTConsumer *CreateASTConsumer(CompilerInstance &, StringRef) {
+      return new CombinedMatchingConsumer(Finder, Owner);
+    }
+
+    virtual bool BeginInvocation(CompilerInstance &CI) LLVM_OVERRIDE {
+      if (Overlay)
+        Overlay->remapFiles(CI.getPreprocessorOpts());
+      return ASTFrontendAction::BeginInvocation(CI);
+    }
+
+    virtual bool BeginSourceFileAction(CompilerInstance &CI,
+                                       StringRef Filename) LLVM_OVERRIDE {
+      if (!ASTFrontendAction::BeginSourceFileAction(CI, Filename))
+        return false;
+
+      return Owner.handleBeginSource(CI, Filename);
+    }
+
+    virtual void EndSourceFileAction() LLVM_OVERRIDE {
+      Owner.handleEndSource();
+      return ASTFrontendAction::EndSourceFileAction();
+    }
+
+  private:
+    MatchFinder &Finder;
+    CombinedTransforms &Owner;
+    const FileOverlay *Overlay;
+  };
+
+  MatchFinder &Finder;
+  CombinedTransforms &Owner;
+  const FileOverlay *Overlay;
+};
+
+/// \brief A replacement made by one transform for one translation unit.
+struct Candidate {
+  Candidate(const Replacement &R, unsigned Index, StringRef Source)
+      : R(&R), Index(Index), Source(Source) {}
+
+  unsigned end() const { return R->getOffset() + R->getLength(); }
+
+  const Replacement *R;
+  unsigned Index;
+  StringRef Source;
+};
+
+bool candidateLess(const Candidate &A, const Candidate &B) {
+  if (A.R->getOffset() != B.R->getOffset())
+    return A.R->getOffset() < B.R->getOffset();
+  return A.Index < B.Index;
+}
+
+/// \brief Whether two replacements in the same file cannot both be applied.
+///
+/// Identical replacements are not in conflict. Replacements starting at the
+/// same offset are, since the order of the insertions would be arbitrary.
+bool conflict(const Replacement &A, const Replacement &B) {
+  if (A.getOffset() == B.getOffset() && A.getLength() == B.getLength() &&
+      A.getReplacementText() == B.getReplacementText())
+    return false;
+  if (A.getOffset() == B.getOffset())
+    return true;
+  return A.getOffset() < B.getOffset() + B.getLength() &&
+         B.getOffset() < A.getOffset() + A.getLength();
+}
+
+} // namespace
+
+CombinedTransforms::CombinedTransforms(
+    const std::vector<Transform *> &Transforms,
+    const std::vector<std::string> &SourcePaths, const FileOverlay *Overlay)
+    : Transforms(Transforms), PendingSources(SourcePaths), FirstPass(true),
+      Overlay(Overlay), Counts(Transforms.size()) {
+  for (unsigned I = 0, E = Transforms.size(); I != E; ++I)
+    Pending.push_back(I);
+}
+
+int CombinedTransforms::runPass(const CompilationDatabase &Database) {
+  MatchFinder Finder;
+  std::vector<unsigned> Registered;
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I) {
+    Transform *T = Transforms[Pending[I]];
+    T->Reset();
+    // Changes of the last pass in headers may have been dropped with the
+    // other changes of a losing translation unit.
+    T->forgetTransformedHeaders();
+    // A retry pass runs each transform on the translation units any transform
+    // retries, and drops the changes of those it is not scheduled for; a
+    // header changed there must not be skipped where it is.
+    T->enableHeaderSkipping(FirstPass);
+    if (T->registerMatchers(Finder))
+      Registered.push_back(Pending[I]);
+    else
+      Unshared.push_back(T);
+  }
+  Pending.swap(Registered);
+  Replacements.clear();
+
+  if (Pending.empty())
+    return 0;
+
+  ClangTool Tool(Database, PendingSources);
+  if (int Result =
+          Tool.run(new CombinedActionFactory(Finder, *this, Overlay))) {
+    llvm::errs() << "Error encountered during translation.\n";
+    return Result;
+  }
+
+  resolveConflicts();
+  return 0;
+}
+
+bool CombinedTransforms::handleBeginSource(CompilerInstance &CI,
+                                           StringRef Filename) {
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I)
+    if (!Transforms[Pending[I]]->handleBeginSource(CI, Filename))
+      return false;
+  return true;
+}
+
+void CombinedTransforms::handleEndSource() {
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I)
+    Transforms[Pending[I]]->handleEndSource();
+}
+
+void CombinedTransforms::handleBeginMatching() {
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I)
+    Transforms[Pending[I]]->handleBeginMatching();
+}
+
+void CombinedTransforms::handleEndMatching() {
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I)
+    Transforms[Pending[I]]->handleEndMatching();
+}
+
+bool CombinedTransforms::isScheduled(unsigned Index, StringRef Source) const {
+  if (FirstPass)
+    return true;
+  std::map<unsigned, std::set<std::string> >::const_iterator I =
+      Retry.find(Index);
+  return I != Retry.end() && I->second.count(Source);
+}
+
+void
+CombinedTransforms::findConflicts(std::set<TransformSource> &Losers) const {
+  // Headers are seen once per including translation unit, so replacements are
+  // grouped by the file they change rather than by translation unit.
+  llvm::StringMap<std::vector<Candidate> > ByFile;
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I) {
+    const TUReplacementsMap &TUs = Transforms[Pending[I]]->getAllReplacements();
+    for (TUReplacementsMap::const_iterator TU = TUs.begin(), TE = TUs.end();
+         TU != TE; ++TU) {
+      if (!isScheduled(Pending[I], TU->getKey()))
+        continue;
+      const std::vector<Replacement> &Rs = TU->getValue().Replacements;
+      for (std::vector<Replacement>::const_iterator R = Rs.begin(),
+                                                    RE = Rs.end();
+           R != RE; ++R)
+        ByFile[R->getFilePath()].push_back(
+            Candidate(*R, Pending[I], TU->getKey()));
+    }
+  }
+
+  for (llvm::StringMap<std::vector<Candidate> >::iterator F = ByFile.begin(),
+                                                          FE = ByFile.end();
+       F != FE; ++F) {
+    std::vector<Candidate> &Candidates = F->getValue();
+    std::sort(Candidates.begin(), Candidates.end(), candidateLess);
+
+    // Candidates whose range may still overlap the next candidate.
+    std::vector<const Candidate *> Open;
+    for (std::vector<Candidate>::const_iterator C = Candidates.begin(),
+                                                CE = Candidates.end();
+         C != CE; ++C) {
+      unsigned Offset = C->R->getOffset();
+      std::vector<const Candidate *>::iterator Keep = Open.begin();
+      for (std::vector<const Candidate *>::iterator O = Open.begin(),
+                                                    OE = Open.end();
+           O != OE; ++O) {
+        if ((*O)->end() <= Offset && (*O)->R->getOffset() != Offset)
+          continue;
+        *Keep++ = *O;
+        if ((*O)->Index == C->Index || !conflict(*(*O)->R, *C->R))
+          continue;
+        const Candidate *Loser = (*O)->Index < C->Index ? &*C : *O;
+        Losers.insert(std::make_pair(Loser->Index, Loser->Source.str()));
+      }
+      Open.erase(Keep, Open.end());
+      Open.push_back(&*C);
+    }
+  }
+}
+
+void CombinedTransforms::resolveConflicts() {
+  std::set<TransformSource> Losers;
+  findConflicts(Losers);
+
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I) {
+    const llvm::StringMap<ChangeCounts> &SourceCounts =
+        Transforms[Pending[I]]->getSourceChangeCounts();
+    ChangeCounts &Total = Counts[Pending[I]];
+    for (llvm::StringMap<ChangeCounts>::const_iterator
+             S = SourceCounts.begin(),
+             SE = SourceCounts.end();
+         S != SE; ++S) {
+      if (!isScheduled(Pending[I], S->getKey()))
+        continue;
+      const ChangeCounts &C = S->getValue();
+      Total.Rejected += C.Rejected;
+      if (Losers.count(std::make_pair(Pending[I], S->getKey().str()))) {
+        Total.Deferred += C.Accepted + C.Deferred;
+        continue;
+      }
+      Total.Accepted += C.Accepted;
+      Total.Deferred += C.Deferred;
+    }
+  }
+
+  for (unsigned I = 0, E = Pending.size(); I != E; ++I) {
+    const TUReplacementsMap &TUs = Transforms[Pending[I]]->getAllReplacements();
+    for (TUReplacementsMap::const_iterator TU = TUs.begin(), TE = TUs.end();
+         TU != TE; ++TU) {
+      if (!isScheduled(Pending[I], TU->getKey()) ||
+          Losers.count(std::make_pair(Pending[I], TU->getKey().str())))
+        continue;
+      TranslationUnitReplacements &Merged = Replacements[TU->getKey()];
+      if (Merged.MainSourceFile.empty())
+        Merged.MainSourceFile = TU->getValue().MainSourceFile;
+      Merged.Replacements.insert(Merged.Replacements.end(),
+                                 TU->getValue().Replacements.begin(),
+                                 TU->getValue().Replacements.end());
+    }
+  }
+
+  // The next pass runs the losers, in order, on the sources they lost in.
+  Retry.clear();
+  std::set<std::string> Sources;
+  for (std::set<TransformSource>::const_iterator I = Losers.begin(),
+                                                 E = Losers.end();
+       I != E; ++I) {
+    Retry[I->first].insert(I->second);
+    Sources.insert(I->second);
+  }
+  Pending.clear();
+  for (std::map<unsigned, std::set<std::string> >::const_iterator
+           I = Retry.begin(),
+           E = Retry.end();
+       I != E; ++I)
+    Pending.push_back(I->first);
+  PendingSources.assign(Sources.begin(), Sources.end());
+  FirstPass = false;
+}
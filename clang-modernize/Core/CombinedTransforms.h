@@ -0,0 +1,110 @@
+//===-- Core/CombinedTransforms.h - Single-parse runner ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the declaration of the CombinedTransforms class
+/// which runs several transforms on a single parse of each translation unit.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_MODERNIZE_COMBINED_TRANSFORMS_H
+#define CLANG_MODERNIZE_COMBINED_TRANSFORMS_H
+
+#include "Core/Transform.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class FileOverlay;
+
+/// \brief Runs several transforms on a single parse of each translation unit.
+///
+/// The matchers of all transforms are registered on one MatchFinder (see
+/// Transform::registerMatchers()). When replacements of different transforms
+/// overlap, the transform that comes first wins: all replacements the losing
+/// transform made for that translation unit are dropped and the translation
+/// unit is scheduled for another pass. The next pass runs only the losing
+/// transforms and parses only the translation units they lost in, so it has
+/// to be run once the replacements of the previous pass have been applied.
+///
+/// Transforms that do not implement registerMatchers() are left out and must
+/// be run separately with Transform::apply().
+class CombinedTransforms {
+public:
+  /// \param Transforms Transforms to run, in order of precedence.
+  /// \param SourcePaths Sources to transform in the first pass.
+  /// \param Overlay Files to parse from memory instead of disk, or null.
+  CombinedTransforms(const std::vector<Transform *> &Transforms,
+                     const std::vector<std::string> &SourcePaths,
+                     const FileOverlay *Overlay = 0);
+
+  /// \brief Query if another pass is needed.
+  bool hasPendingPass() const { return !Pending.empty(); }
+
+  /// \brief Run the pending transforms on the pending sources.
+  ///
+  /// \returns \li 0 if successful
+  ///          \li the result of ClangTool::run() otherwise
+  int runPass(const clang::tooling::CompilationDatabase &Database);
+
+  /// \brief Accessor to the conflict-free replacements of the last pass.
+  const TUReplacementsMap &getReplacements() const { return Replacements; }
+
+  /// \brief Query the change counts of the \p Index-th transform summed over
+  /// all passes.
+  const ChangeCounts &getChangeCounts(unsigned Index) const {
+    return Counts[Index];
+  }
+
+  /// \brief Transforms that cannot share a parse, to be run with apply().
+  const std::vector<Transform *> &getUnsharedTransforms() const {
+    return Unshared;
+  }
+
+  /// \brief Called by the frontend action before parsing a translation unit.
+  bool handleBeginSource(clang::CompilerInstance &CI, llvm::StringRef Filename);
+
+  /// \brief Called by the frontend action after a translation unit was run.
+  void handleEndSource();
+
+  /// \brief Called once the translation unit is parsed, before the shared
+  /// matchers run over it.
+  void handleBeginMatching();
+
+  /// \brief Called once the shared matchers ran over the translation unit.
+  void handleEndMatching();
+
+private:
+  typedef std::pair<unsigned, std::string> TransformSource;
+
+  /// \brief Whether the replacements of the \p Index-th transform for
+  /// \p Source count in the current pass.
+  bool isScheduled(unsigned Index, llvm::StringRef Source) const;
+
+  /// \brief Find the (transform, source) pairs whose replacements overlap
+  /// those of an earlier transform.
+  void findConflicts(std::set<TransformSource> &Losers) const;
+
+  /// \brief Fill Replacements and Counts and set up the next pass.
+  void resolveConflicts();
+
+  const std::vector<Transform *> Transforms;
+  std::vector<Transform *> Unshared;
+  std::vector<unsigned> Pending;
+  std::vector<std::string> PendingSources;
+  std::map<unsigned, std::set<std::string> > Retry;
+  bool FirstPass;
+  const FileOverlay *Overlay;
+
+  TUReplacementsMap Replacements;
+  std::vector<ChangeCounts> Counts;
+};
+
+#endif // CLANG_MODERNIZE_COMBINED_TRANSFORMS_H
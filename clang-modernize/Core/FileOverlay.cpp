@@ -0,0 +1,81 @@
+//===-- Core/FileOverlay.cpp - In-memory file contents --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the definition of the FileOverlay class which
+/// holds the new contents of changed files until they are written.
+///
+//===----------------------------------------------------------------------===//
+
+#include "Core/FileOverlay.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace path = llvm::sys::path;
+
+bool FileOverlay::contains(llvm::StringRef FilePath) const {
+  llvm::SmallString<128> CanonicalPath(FilePath);
+  makeCanonical(CanonicalPath);
+  return Files.count(CanonicalPath.str());
+}
+
+void FileOverlay::makeCanonical(llvm::SmallVectorImpl<char> &Path) {
+  llvm::sys::fs::make_absolute(Path);
+  llvm::StringRef Absolute(Path.data(), Path.size());
+
+  // Dot components are removed lexically, as headers reached through
+  // different include directories are named e.g. dir/../header.h.
+  llvm::StringRef Relative = path::relative_path(Absolute);
+  llvm::SmallVector<llvm::StringRef, 16> Components;
+  for (path::const_iterator I = path::begin(Relative), E = path::end(Relative);
+       I != E; ++I) {
+    if (*I == ".")
+      continue;
+    if (*I == "..") {
+      if (!Components.empty())
+        Components.pop_back();
+      continue;
+    }
+    Components.push_back(*I);
+  }
+
+  llvm::SmallString<128> Canonical(path::root_path(Absolute));
+  for (unsigned I = 0, E = Components.size(); I != E; ++I)
+    path::append(Canonical, Components[I]);
+  Path.assign(Canonical.begin(), Canonical.end());
+}
+
+void FileOverlay::remapFiles(clang::PreprocessorOptions &Opts) const {
+  // The SourceManager takes ownership of the buffers, which only reference
+  // the contents of the overlay.
+  Opts.RetainRemappedFileBuffers = false;
+  for (const_iterator I = Files.begin(), E = Files.end(); I != E; ++I)
+    Opts.addRemappedFile(
+        I->getKey(),
+        llvm::MemoryBuffer::getMemBuffer(I->getValue(), I->getKey()));
+}
+
+bool FileOverlay::writeFiles() const {
+  bool Success = true;
+  for (const_iterator I = Files.begin(), E = Files.end(); I != E; ++I) {
+    std::string ErrorInfo;
+    llvm::raw_fd_ostream FileStream(I->getKey().str().c_str(), ErrorInfo);
+    if (!ErrorInfo.empty()) {
+      llvm::errs() << "Could not open " << I->getKey() << " for writing\n";
+      Success = false;
+      continue;
+    }
+    FileStream << I->getValue();
+  }
+  return Success;
+}
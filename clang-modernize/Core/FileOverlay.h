@@ -0,0 +1,70 @@
+//===-- Core/FileOverlay.h - In-memory file contents ------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the declaration of the FileOverlay class which
+/// holds the new contents of changed files until they are written.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_MODERNIZE_FILE_OVERLAY_H
+#define CLANG_MODERNIZE_FILE_OVERLAY_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+namespace clang {
+class PreprocessorOptions;
+} // namespace clang
+
+/// \brief New contents of files changed by the transforms, kept in memory
+/// instead of being written to disk.
+///
+/// Files are keyed by canonical absolute path, s. makeCanonical(). Frontend actions parse the contents of
+/// the overlay instead of those on disk once they called remapFiles().
+class FileOverlay {
+public:
+  typedef llvm::StringMap<std::string>::const_iterator const_iterator;
+
+  const_iterator begin() const { return Files.begin(); }
+  const_iterator end() const { return Files.end(); }
+  bool empty() const { return Files.empty(); }
+
+  /// \brief Query if \p FilePath, relative to the current directory if not
+  /// absolute, has contents in the overlay.
+  bool contains(llvm::StringRef FilePath) const;
+
+  /// \brief Turn \p Path into the key of its file in the overlay: the
+  /// absolute path without \c . and \c .. components.
+  static void makeCanonical(llvm::SmallVectorImpl<char> &Path);
+
+  /// \brief Accessor to the contents of all files, by canonical path, to be
+  /// updated with clang::replace::rewriteFileContents().
+  llvm::StringMap<std::string> &getFiles() { return Files; }
+
+  /// \brief Make the preprocessor created with \p Opts read the files of the
+  /// overlay from memory.
+  ///
+  /// To be called from FrontendAction::BeginInvocation(). The overlay must
+  /// not be changed until the frontend action ends.
+  void remapFiles(clang::PreprocessorOptions &Opts) const;
+
+  /// \brief Write all files of the overlay to disk.
+  ///
+  /// \returns \li true if all files were written
+  ///          \li false otherwise
+  bool writeFiles() const;
+
+private:
+  llvm::StringMap<std::string> Files;
+};
+
+#endif // CLANG_MODERNIZE_FILE_OVERLAY_H
@@ -26,32 +26,15 @@ using namespace llvm;
 typedef SmallString<64> PathString;
 
 namespace {
-/// \brief Helper function to determine whether a file has the same path
-/// prefix as \a Path.
+/// \brief Helper function to convert a component of a path as returned by
+/// sys::path iterators to the form used by PathTrie.
 ///
-/// \a Path must be an absolute path.
-bool fileHasPathPrefix(StringRef File, StringRef Path) {
-  // Converts File to its absolute path.
-  PathString AbsoluteFile = File;
-  sys::fs::make_absolute(AbsoluteFile);
-
-  // Convert path strings to sys::path to iterate over each of its directories.
-  sys::path::const_iterator FileI = sys::path::begin(AbsoluteFile),
-                            FileE = sys::path::end(AbsoluteFile),
-                            PathI = sys::path::begin(Path),
-                            PathE = sys::path::end(Path);
-  while (FileI != FileE && PathI != PathE) {
-    // If the strings aren't equal then the two paths aren't contained within
-    // each other.
-    bool IsSeparator = ((FileI->size() == 1) && (PathI->size() == 1) &&
-                        sys::path::is_separator((*FileI)[0]) &&
-                        sys::path::is_separator((*PathI)[0]));
-    if (!FileI->equals(*PathI) && !IsSeparator)
-      return false;
-    ++FileI;
-    ++PathI;
-  }
-  return true;
+/// All separators are considered equal so that paths read from the lists and
+/// paths being checked can use different separators.
+StringRef normalizeComponent(StringRef Component) {
+  if (Component.size() == 1 && sys::path::is_separator(Component[0]))
+    return "/";
+  return Component;
 }
 
 /// \brief Helper function for removing relative operators from a given
@@ -81,9 +64,9 @@ std::string removeRelativeOperators(StringRef Path) {
 }
 
 /// \brief Helper function to tokenize a string of paths and populate
-/// the vector.
+/// the vector and the trie.
 error_code parseCLInput(StringRef Line, std::vector<std::string> &List,
-                        StringRef Separator) {
+                        PathTrie &Trie, StringRef Separator) {
   SmallVector<StringRef, 32> Tokens;
   Line.split(Tokens, Separator, /*MaxSplit=*/ -1, /*KeepEmpty=*/ false);
   for (SmallVectorImpl<StringRef>::iterator I = Tokens.begin(),
@@ -96,9 +79,10 @@ error_code parseCLInput(StringRef Line, std::vector<std::string> &List,
     // Remove relative operators from the path.
     std::string AbsPath = removeRelativeOperators(Path);
     // Add only non-empty paths to the list.
-    if (!AbsPath.empty())
+    if (!AbsPath.empty()) {
       List.push_back(AbsPath);
-    else
+      Trie.insert(AbsPath);
+    } else
       llvm::errs() << "Unable to parse input path: " << *I << "\n";
 
     llvm::errs() << "Parse: " <<List.back() << "\n";
@@ -107,12 +91,59 @@ error_code parseCLInput(StringRef Line, std::vector<std::string> &List,
 }
 } // end anonymous namespace
 
+void PathTrie::getEdgeKey(unsigned Node, StringRef Component,
+                          SmallVectorImpl<char> &Key) {
+  Key.clear();
+  raw_svector_ostream OS(Key);
+  OS << Node << '/' << normalizeComponent(Component);
+  OS.flush();
+}
+
+void PathTrie::insert(StringRef Path) {
+  unsigned Node = 0;
+  SmallString<64> Key;
+  for (sys::path::const_iterator I = sys::path::begin(Path),
+                                 E = sys::path::end(Path);
+       I != E; ++I) {
+    getEdgeKey(Node, *I, Key);
+    unsigned &Child = Edges[Key];
+    if (!Child) {
+      Child = Ends.size();
+      Ends.push_back(false);
+    }
+    Node = Child;
+  }
+  Ends[Node] = true;
+}
+
+bool PathTrie::hasPrefixOf(StringRef Path) const {
+  if (Edges.empty())
+    return false;
+
+  unsigned Node = 0;
+  SmallString<64> Key;
+  for (sys::path::const_iterator I = sys::path::begin(Path),
+                                 E = sys::path::end(Path);
+       I != E; ++I) {
+    if (Ends[Node])
+      return true;
+    getEdgeKey(Node, *I, Key);
+    StringMap<unsigned>::const_iterator Child = Edges.find(Key);
+    if (Child == Edges.end())
+      return false;
+    Node = Child->getValue();
+  }
+  // All the components of Path matched: either a listed path ends here or
+  // Path is one of their parent directories, which counts as a match too.
+  return true;
+}
+
 error_code IncludeExcludeInfo::readListFromString(StringRef IncludeString,
                                                   StringRef ExcludeString) {
-  if (error_code Err = parseCLInput(IncludeString, IncludeList,
+  if (error_code Err = parseCLInput(IncludeString, IncludeList, IncludeTrie,
                                     /*Separator=*/ ","))
     return Err;
-  if (error_code Err = parseCLInput(ExcludeString, ExcludeList,
+  if (error_code Err = parseCLInput(ExcludeString, ExcludeList, ExcludeTrie,
                                     /*Separator=*/ ","))
     return Err;
   return error_code::success();
@@ -127,6 +158,7 @@ error_code IncludeExcludeInfo::readListFromFile(StringRef IncludeListFile,
       return Err;
     }
     if (error_code Err = parseCLInput(FileBuf->getBuffer(), IncludeList,
+                                      IncludeTrie,
                                       /*Separator=*/ "\n"))
       return Err;
   }
@@ -137,6 +169,7 @@ error_code IncludeExcludeInfo::readListFromFile(StringRef IncludeListFile,
       return Err;
     }
     if (error_code Err = parseCLInput(FileBuf->getBuffer(), ExcludeList,
+                                      ExcludeTrie,
                                       /*Separator=*/ "\n"))
       return Err;
   }
@@ -144,30 +177,21 @@ error_code IncludeExcludeInfo::readListFromFile(StringRef IncludeListFile,
 }
 
 bool IncludeExcludeInfo::isFileIncluded(StringRef FilePath) const {
-  bool InIncludeList = false;
-
-  for (std::vector<std::string>::const_iterator I = IncludeList.begin(),
-                                                E = IncludeList.end();
-       I != E; ++I)
-    if ((InIncludeList = fileHasPathPrefix(FilePath, *I)))
-      break;
+  PathString AbsoluteFile = FilePath;
+  sys::fs::make_absolute(AbsoluteFile);
 
   // If file is not in the list of included paths then it is not necessary
   // to check the excluded path list.
-  if (!InIncludeList)
+  if (!IncludeTrie.hasPrefixOf(AbsoluteFile))
     return false;
 
   // If the file is in the included list but not is not explicitly excluded,
   // then it is safe to transform.
-  return !isFileExplicitlyExcluded(FilePath);
+  return !ExcludeTrie.hasPrefixOf(AbsoluteFile);
 }
 
 bool IncludeExcludeInfo::isFileExplicitlyExcluded(StringRef FilePath) const {
-  for (std::vector<std::string>::const_iterator I = ExcludeList.begin(),
-                                                E = ExcludeList.end();
-      I != E; ++I)
-    if (fileHasPathPrefix(FilePath, *I))
-      return true;
-
-  return false;
+  PathString AbsoluteFile = FilePath;
+  sys::fs::make_absolute(AbsoluteFile);
+  return ExcludeTrie.hasPrefixOf(AbsoluteFile);
 }
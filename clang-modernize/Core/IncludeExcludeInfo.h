@@ -16,10 +16,35 @@
 #ifndef CLANG_MODERNIZE_INCLUDEEXCLUDEINFO_H
 #define CLANG_MODERNIZE_INCLUDEEXCLUDEINFO_H
 
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/system_error.h"
 #include <vector>
 
+/// \brief Trie of the components of a list of paths, to match a path against
+/// the whole list in a single walk over its components.
+class PathTrie {
+public:
+  PathTrie() : Ends(1, false) {}
+
+  /// \brief Add \a Path, an absolute path without relative operators.
+  void insert(llvm::StringRef Path);
+
+  /// \brief Determine if a path of the trie is a prefix of the absolute path
+  /// \a Path.
+  bool hasPrefixOf(llvm::StringRef Path) const;
+
+private:
+  /// \brief Key in Edges of the child \a Component of node \a Node.
+  static void getEdgeKey(unsigned Node, llvm::StringRef Component,
+                         llvm::SmallVectorImpl<char> &Key);
+
+  llvm::StringMap<unsigned> Edges;
+  /// Whether a path of the list ends at each node. Node 0 is the root.
+  std::vector<bool> Ends;
+};
+
 /// \brief Class encapsulating the handling of include and exclude paths
 /// provided by the user through command line options.
 class IncludeExcludeInfo {
@@ -54,9 +79,15 @@ public:
   /// \brief Determine if a list of include paths was provided.
   bool isIncludeListEmpty() const { return IncludeList.empty(); }
 
+  /// \brief Accessors to the parsed lists of include and exclude paths.
+  const std::vector<std::string> &getIncludeList() const { return IncludeList; }
+  const std::vector<std::string> &getExcludeList() const { return ExcludeList; }
+
 private:
   std::vector<std::string> IncludeList;
   std::vector<std::string> ExcludeList;
+  PathTrie IncludeTrie;
+  PathTrie ExcludeTrie;
 };
 
 #endif // CLANG_MODERNIZE_INCLUDEEXCLUDEINFO_H
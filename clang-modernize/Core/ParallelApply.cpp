@@ -0,0 +1,333 @@
+//===-- Core/ParallelApply.cpp - Apply a transform in parallel ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the definitions of applyInParallel() and
+/// checkSyntaxInParallel() which run on several translation units at once.
+///
+//===----------------------------------------------------------------------===//
+
+#include "Core/ParallelApply.h"
+#include "Core/FileOverlay.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/Threading.h"
+
+#if LLVM_ENABLE_THREADS != 0 && defined(LLVM_ON_UNIX)
+#include <pthread.h>
+#define CLANG_MODERNIZE_USE_PTHREADS 1
+#endif
+
+using namespace clang;
+using namespace clang::tooling;
+
+namespace {
+
+/// \brief State shared by the workers of one applyInParallel() call.
+struct WorkQueue {
+  WorkQueue(Transform &Owner, const CompilationDatabase &Database,
+            const std::vector<std::string> &SourcePaths)
+      : Owner(Owner), Database(Database), SourcePaths(SourcePaths), Next(0),
+        Failed(false) {}
+
+  Transform &Owner;
+  const CompilationDatabase &Database;
+  const std::vector<std::string> &SourcePaths;
+
+  /// \brief Guards Owner, Next and Failed.
+  llvm::sys::Mutex Lock;
+  unsigned Next;
+  bool Failed;
+};
+
+struct Worker {
+  WorkQueue *Queue;
+  Transform *Copy;
+};
+
+void runWorker(Worker &W) {
+  WorkQueue &Q = *W.Queue;
+  for (;;) {
+    std::vector<std::string> Source;
+    {
+      llvm::MutexGuard Guard(Q.Lock);
+      if (Q.Next == Q.SourcePaths.size())
+        return;
+      Source.push_back(Q.SourcePaths[Q.Next++]);
+    }
+
+    int Result = W.Copy->apply(Q.Database, Source);
+
+    llvm::MutexGuard Guard(Q.Lock);
+    if (Result != 0)
+      Q.Failed = true;
+    Q.Owner.takeResults(*W.Copy);
+  }
+}
+
+/// \brief Run the workers \p Run(\p Args[I]), each on its own thread, until
+/// they all return.
+///
+/// Workers must take their work from a shared queue: the calling thread is the
+/// first worker and a thread that cannot be created just leaves its share of
+/// the work to the others. Without thread support the workers are run one
+/// after the other.
+void runOnThreads(void *(*Run)(void *), const std::vector<void *> &Args) {
+#ifdef CLANG_MODERNIZE_USE_PTHREADS
+  // Clang and LLVM only guard their global state when told threads are used.
+  llvm::llvm_start_multithreaded();
+
+  std::vector<pthread_t> Threads;
+  for (unsigned I = 1, E = Args.size(); I != E; ++I) {
+    pthread_t Thread;
+    if (pthread_create(&Thread, 0, Run, Args[I]) == 0)
+      Threads.push_back(Thread);
+  }
+  Run(Args[0]);
+  for (unsigned I = 0, E = Threads.size(); I != E; ++I)
+    pthread_join(Threads[I], 0);
+#else
+  for (unsigned I = 0, E = Args.size(); I != E; ++I)
+    Run(Args[I]);
+#endif
+}
+
+void *runWorkerThread(void *Arg) {
+  runWorker(*static_cast<Worker *>(Arg));
+  return 0;
+}
+
+/// \brief PPCallbacks telling whether the preprocessor entered a file of an
+/// overlay.
+class ChangedFileFinder : public PPCallbacks {
+public:
+  ChangedFileFinder(const SourceManager &SM, const FileOverlay &Overlay,
+                    bool &Found)
+      : SM(SM), Overlay(Overlay), Found(Found) {}
+
+  virtual void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                           SrcMgr::CharacteristicKind FileType,
+                           FileID PrevFID) LLVM_OVERRIDE {
+    if (Found || Reason != EnterFile)
+      return;
+    const FileEntry *Entry = SM.getFileEntryForID(SM.getFileID(Loc));
+    if (Entry && Overlay.contains(Entry->getName()))
+      Found = true;
+  }
+
+private:
+  const SourceManager &SM;
+  const FileOverlay &Overlay;
+  bool &Found;
+};
+
+/// \brief FrontendAction preprocessing a translation unit to find whether it
+/// includes a file of an overlay, directly or not.
+class ChangedFileAction : public PreprocessorFrontendAction {
+public:
+  ChangedFileAction(const FileOverlay &Overlay, bool &Found)
+      : Overlay(Overlay), Found(Found) {}
+
+protected:
+  virtual bool BeginInvocation(CompilerInstance &CI) LLVM_OVERRIDE {
+    Overlay.remapFiles(CI.getPreprocessorOpts());
+    return PreprocessorFrontendAction::BeginInvocation(CI);
+  }
+
+  virtual void ExecuteAction() LLVM_OVERRIDE {
+    CompilerInstance &CI = getCompilerInstance();
+    Preprocessor &PP = CI.getPreprocessor();
+    PP.addPPCallbacks(
+        new ChangedFileFinder(CI.getSourceManager(), Overlay, Found));
+
+    Token Tok;
+    PP.EnterMainSourceFile();
+    do
+      PP.Lex(Tok);
+    while (Tok.isNot(tok::eof) && !Found);
+  }
+
+private:
+  const FileOverlay &Overlay;
+  bool &Found;
+};
+
+/// \brief SyntaxOnlyAction parsing the files of an overlay from memory.
+class OverlaySyntaxOnlyAction : public SyntaxOnlyAction {
+public:
+  explicit OverlaySyntaxOnlyAction(const FileOverlay &Overlay)
+      : Overlay(Overlay) {}
+
+protected:
+  virtual bool BeginInvocation(CompilerInstance &CI) LLVM_OVERRIDE {
+    Overlay.remapFiles(CI.getPreprocessorOpts());
+    return SyntaxOnlyAction::BeginInvocation(CI);
+  }
+
+private:
+  const FileOverlay &Overlay;
+};
+
+class ChangedFileActionFactory : public FrontendActionFactory {
+public:
+  ChangedFileActionFactory(const FileOverlay &Overlay, bool &Found)
+      : Overlay(Overlay), Found(Found) {}
+
+  virtual FrontendAction *create() LLVM_OVERRIDE {
+    return new ChangedFileAction(Overlay, Found);
+  }
+
+private:
+  const FileOverlay &Overlay;
+  bool &Found;
+};
+
+class SyntaxCheckActionFactory : public FrontendActionFactory {
+public:
+  explicit SyntaxCheckActionFactory(const FileOverlay &Overlay)
+      : Overlay(Overlay) {}
+
+  virtual FrontendAction *create() LLVM_OVERRIDE {
+    return new OverlaySyntaxOnlyAction(Overlay);
+  }
+
+private:
+  const FileOverlay &Overlay;
+};
+
+/// \brief State shared by the workers of one checkSyntaxInParallel() call.
+struct CheckQueue {
+  CheckQueue(const CompilationDatabase &Database,
+             const std::vector<std::string> &SourcePaths,
+             const FileOverlay &Overlay)
+      : Database(Database), SourcePaths(SourcePaths), Overlay(Overlay),
+        Next(0), Failed(false) {}
+
+  const CompilationDatabase &Database;
+  const std::vector<std::string> &SourcePaths;
+  const FileOverlay &Overlay;
+
+  /// \brief Guards Next and Failed.
+  llvm::sys::Mutex Lock;
+  unsigned Next;
+  bool Failed;
+};
+
+/// \brief Make the paths in \p SourcePaths absolute before the working
+/// directory of the process changes under the workers.
+std::vector<std::string>
+makeAbsolute(const std::vector<std::string> &SourcePaths) {
+  std::vector<std::string> AbsolutePaths;
+  for (std::vector<std::string>::const_iterator I = SourcePaths.begin(),
+                                                E = SourcePaths.end();
+       I != E; ++I) {
+    llvm::SmallString<128> Path(*I);
+    llvm::sys::fs::make_absolute(Path);
+    AbsolutePaths.push_back(Path.str());
+  }
+  return AbsolutePaths;
+}
+
+void *runCheckerThread(void *Arg) {
+  CheckQueue &Q = *static_cast<CheckQueue *>(Arg);
+  for (;;) {
+    std::vector<std::string> Source;
+    {
+      llvm::MutexGuard Guard(Q.Lock);
+      if (Q.Next == Q.SourcePaths.size())
+        return 0;
+      Source.push_back(Q.SourcePaths[Q.Next++]);
+    }
+
+    // Preprocessing is much cheaper than parsing. A source that cannot be
+    // preprocessed is parsed anyway to report why.
+    bool Changed = false;
+    ClangTool FinderTool(Q.Database, Source);
+    ChangedFileActionFactory FinderFactory(Q.Overlay, Changed);
+    if (FinderTool.run(&FinderFactory) == 0 && !Changed)
+      continue;
+
+    ClangTool SyntaxTool(Q.Database, Source);
+    SyntaxCheckActionFactory SyntaxFactory(Q.Overlay);
+    if (SyntaxTool.run(&SyntaxFactory) != 0) {
+      llvm::MutexGuard Guard(Q.Lock);
+      Q.Failed = true;
+    }
+  }
+}
+
+} // namespace
+
+bool haveCommonDirectory(const CompilationDatabase &Database,
+                         const std::vector<std::string> &SourcePaths) {
+  std::vector<std::string> AbsolutePaths = makeAbsolute(SourcePaths);
+  bool HaveDirectory = false;
+  std::string Directory;
+  for (std::vector<std::string>::const_iterator I = AbsolutePaths.begin(),
+                                                E = AbsolutePaths.end();
+       I != E; ++I) {
+    std::vector<CompileCommand> Commands = Database.getCompileCommands(*I);
+    for (std::vector<CompileCommand>::const_iterator C = Commands.begin(),
+                                                     CE = Commands.end();
+         C != CE; ++C) {
+      if (!HaveDirectory) {
+        Directory = C->Directory;
+        HaveDirectory = true;
+      } else if (C->Directory != Directory)
+        return false;
+    }
+  }
+  return true;
+}
+
+int applyInParallel(Transform &T, const std::vector<Transform *> &Copies,
+                    const CompilationDatabase &Database,
+                    const std::vector<std::string> &SourcePaths) {
+  assert(!Copies.empty() && "No transform copies to run");
+
+  T.Reset();
+  std::vector<std::string> AbsolutePaths = makeAbsolute(SourcePaths);
+  WorkQueue Queue(T, Database, AbsolutePaths);
+  std::vector<Worker> Workers(Copies.size());
+  for (unsigned I = 0, E = Copies.size(); I != E; ++I) {
+    Workers[I].Queue = &Queue;
+    Workers[I].Copy = Copies[I];
+  }
+
+  std::vector<void *> Args;
+  for (unsigned I = 0, E = Workers.size(); I != E; ++I)
+    Args.push_back(&Workers[I]);
+  runOnThreads(runWorkerThread, Args);
+
+  return Queue.Failed ? 1 : 0;
+}
+
+int checkSyntaxInParallel(const CompilationDatabase &Database,
+                          const std::vector<std::string> &SourcePaths,
+                          const FileOverlay &Overlay, unsigned Jobs) {
+  assert(Jobs > 0 && "No thread to check the sources on");
+  if (Overlay.empty())
+    return 0;
+
+  // Every worker takes the next source from the shared queue.
+  std::vector<std::string> AbsolutePaths = makeAbsolute(SourcePaths);
+  CheckQueue Queue(Database, AbsolutePaths, Overlay);
+  runOnThreads(runCheckerThread, std::vector<void *>(Jobs, &Queue));
+
+  return Queue.Failed ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+//===-- Core/ParallelApply.h - Apply a transform in parallel ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the declarations of applyInParallel() and
+/// checkSyntaxInParallel() which run on several translation units at once.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_MODERNIZE_PARALLEL_APPLY_H
+#define CLANG_MODERNIZE_PARALLEL_APPLY_H
+
+#include "Core/Transform.h"
+#include <string>
+#include <vector>
+
+class FileOverlay;
+
+/// \brief Query whether the compile commands of all sources listed in
+/// \p SourcePaths run in the same directory.
+///
+/// ClangTool::run() changes the working directory of the process to the one
+/// of each compile command it runs. Relative paths in the compile commands of
+/// workers running at the same time would be resolved against the directory of
+/// another worker, so applyInParallel() and checkSyntaxInParallel() must only
+/// be used with more than one worker if this returns true.
+bool haveCommonDirectory(const clang::tooling::CompilationDatabase &Database,
+                         const std::vector<std::string> &SourcePaths);
+
+/// \brief Apply a transform to all files listed in \p SourcePaths with one
+/// worker thread per element of \p Copies.
+///
+/// Each worker applies its own copy of \p T (see Transforms::createCopies())
+/// to one source at a time, so per-translation-unit state is never shared
+/// between threads. After each source the results of the copy are moved into
+/// \p T with Transform::takeResults().
+///
+/// Without thread support the copies are run one after the other.
+///
+/// \returns \li 0 if all sources were transformed successfully
+///          \li 1 otherwise
+int applyInParallel(Transform &T, const std::vector<Transform *> &Copies,
+                    const clang::tooling::CompilationDatabase &Database,
+                    const std::vector<std::string> &SourcePaths);
+
+/// \brief Check the syntax of the sources listed in \p SourcePaths that
+/// include a file of \p Overlay, directly or not, with \p Jobs worker
+/// threads.
+///
+/// Files of \p Overlay are parsed from memory. Each source is preprocessed
+/// first to find out whether it includes a file of \p Overlay; the other
+/// sources are not parsed.
+///
+/// \returns \li 0 if all checked sources are free of errors
+///          \li 1 otherwise
+int checkSyntaxInParallel(const clang::tooling::CompilationDatabase &Database,
+                          const std::vector<std::string> &SourcePaths,
+                          const FileOverlay &Overlay, unsigned Jobs);
+
+#endif // CLANG_MODERNIZE_PARALLEL_APPLY_H
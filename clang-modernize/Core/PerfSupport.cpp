@@ -13,11 +13,94 @@
 //===----------------------------------------------------------------------===//
 
 #include "PerfSupport.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+/// Write \p S as a JSON string literal.
+void writeJSONString(llvm::raw_ostream &OS, llvm::StringRef S) {
+  OS << '"';
+  for (llvm::StringRef::iterator I = S.begin(), E = S.end(); I != E; ++I) {
+    if (*I == '"' || *I == '\\')
+      OS << '\\' << *I;
+    else if (static_cast<unsigned char>(*I) < 0x20)
+      OS << llvm::format("\\u%04x", *I);
+    else
+      OS << *I;
+  }
+  OS << '"';
+}
+
+/// Nearest-rank \p P-th percentile of the non-empty \p Sorted values.
+double percentile(const std::vector<double> &Sorted, unsigned P) {
+  size_t Rank = (P * Sorted.size() + 99) / 100;
+  return Sorted[Rank > 0 ? Rank - 1 : 0];
+}
+
+/// A source or phase of the trace, with the thread it is drawn on.
+struct TraceSpan {
+  TraceSpan(double Start, double End, const ProfileData::SourceEntry *Source,
+            const ProfileData::PhaseEntry *Phase)
+      : Start(Start), End(End), Source(Source), Phase(Phase), Lane(0) {}
+
+  bool operator<(const TraceSpan &RHS) const { return Start < RHS.Start; }
+
+  double Start;
+  double End;
+  const ProfileData::SourceEntry *Source;
+  const ProfileData::PhaseEntry *Phase;
+  unsigned Lane;
+};
+
+void writeTraceEvent(llvm::raw_ostream &OS, bool &First, llvm::StringRef Name,
+                     llvm::StringRef Category, double Start, double Duration,
+                     unsigned Lane) {
+  if (!First)
+    OS << ",\n";
+  First = false;
+  OS << "    { \"name\" : ";
+  writeJSONString(OS, Name);
+  OS << ", \"cat\" : ";
+  writeJSONString(OS, Category);
+  // Timestamps and durations are in microseconds.
+  OS << ", \"ph\" : \"X\", \"ts\" : " << llvm::format("%.0f", Start * 1e6)
+     << ", \"dur\" : " << llvm::format("%.0f", Duration * 1e6)
+     << ", \"pid\" : 1, \"tid\" : " << Lane << " }";
+}
+
+/// Write the percentiles, maximum and total of \p Values, given in seconds, as
+/// a row of the summary in milliseconds.
+void writeSummaryRow(llvm::raw_ostream &OS, llvm::StringRef Name,
+                     std::vector<double> Values) {
+  std::sort(Values.begin(), Values.end());
+  double Total = 0;
+  for (unsigned I = 0, E = Values.size(); I != E; ++I)
+    Total += Values[I];
+  OS << llvm::format("  %-12s", Name.str().c_str());
+  if (Values.empty()) {
+    OS << "\n";
+    return;
+  }
+  OS << llvm::format("%12.2f%12.2f%12.2f%12.2f%12.2f\n",
+                     percentile(Values, 50) * 1000.0,
+                     percentile(Values, 90) * 1000.0,
+                     percentile(Values, 99) * 1000.0, Values.back() * 1000.0,
+                     Total * 1000.0);
+}
+
+} // namespace
 
 void collectSourcePerfData(const Transform &T, SourcePerfData &Data) {
   for (Transform::TimingVec::const_iterator I = T.timing_begin(),
@@ -30,28 +113,31 @@ void collectSourcePerfData(const Transform &T, SourcePerfData &Data) {
   }
 }
 
-void writePerfDataJSON(
+std::string writePerfDataJSON(
     const llvm::StringRef DirectoryName,
     const SourcePerfData &TimingResults) {
   // Create directory path if it doesn't exist
   llvm::sys::fs::create_directories(DirectoryName);
 
-  // Get PID and current time.
-  // FIXME: id_type on Windows is NOT a process id despite the function name.
-  // Need to call GetProcessId() providing it what get_id() returns. For now
-  // disabling PID-based file names until this is fixed properly.
-  //llvm::sys::self_process *SP = llvm::sys::process::get_self();
-  //id_type Pid = SP->get_id();
-  unsigned Pid = 0;
+  // createUniqueFile() replaces the '%' with random characters and fails
+  // rather than opening an existing file, so concurrent runs started within
+  // the same second do not overwrite each other's data.
   llvm::TimeRecord T = llvm::TimeRecord::getCurrentTime();
+  llvm::SmallString<128> Model(DirectoryName);
+  llvm::sys::path::append(Model,
+                          llvm::Twine(static_cast<int>(T.getWallTime())) +
+                              "_%%%%%%%%.json");
 
-  std::string FileName;
-  llvm::raw_string_ostream SS(FileName);
-  SS << DirectoryName << "/" << static_cast<int>(T.getWallTime()) << "_" << Pid
-     << ".json";
+  int FD;
+  llvm::SmallString<128> FileName;
+  if (llvm::error_code EC =
+          llvm::sys::fs::createUniqueFile(Model.str(), FD, FileName)) {
+    llvm::errs() << "Error creating perf data file in " << DirectoryName
+                 << ": " << EC.message() << "\n";
+    return std::string();
+  }
 
-  std::string ErrorInfo;
-  llvm::raw_fd_ostream FileStream(SS.str().c_str(), ErrorInfo);
+  llvm::raw_fd_ostream FileStream(FD, /*shouldClose=*/true);
   FileStream << "{\n";
   FileStream << "  \"Sources\" : [\n";
   for (SourcePerfData::const_iterator I = TimingResults.begin(),
@@ -85,6 +171,207 @@ void writePerfDataJSON(
   }
   FileStream << "\n  ]\n";
   FileStream << "}";
+  return FileName.str();
+}
+
+void collectProfileData(const Transform &T, ProfileData &Data) {
+  for (Transform::ProfileVec::const_iterator I = T.profile_begin(),
+                                             E = T.profile_end();
+       I != E; ++I) {
+    ProfileData::SourceEntry Entry;
+    Entry.Transform = T.getName();
+    Entry.Source = I->first;
+    Entry.Profile = I->second;
+    Data.Sources.push_back(Entry);
+  }
+
+  const llvm::StringMap<CallbackProfile> &Callbacks = T.getCallbackProfiles();
+  for (llvm::StringMap<CallbackProfile>::const_iterator I = Callbacks.begin(),
+                                                        E = Callbacks.end();
+       I != E; ++I) {
+    CallbackProfile &Profile = Data.Callbacks[T.getName()][I->getKey()];
+    Profile.Count += I->getValue().Count;
+    Profile.WallTime += I->getValue().WallTime;
+  }
+}
+
+void writeChromeTrace(llvm::raw_ostream &OS, const ProfileData &Data) {
+  std::vector<TraceSpan> Spans;
+  for (std::vector<ProfileData::SourceEntry>::const_iterator
+           I = Data.Sources.begin(),
+           E = Data.Sources.end();
+       I != E; ++I)
+    Spans.push_back(TraceSpan(I->Profile.Start,
+                              I->Profile.Start +
+                                  I->Profile.Total.getWallTime(),
+                              &*I, 0));
+  for (std::vector<ProfileData::PhaseEntry>::const_iterator
+           I = Data.Phases.begin(),
+           E = Data.Phases.end();
+       I != E; ++I)
+    Spans.push_back(
+        TraceSpan(I->Start, I->Start + I->Time.getWallTime(), 0, &*I));
+  std::stable_sort(Spans.begin(), Spans.end());
+
+  // Put each span on the first thread that is free when it starts.
+  std::vector<double> LaneEnds;
+  for (std::vector<TraceSpan>::iterator I = Spans.begin(), E = Spans.end();
+       I != E; ++I) {
+    unsigned Lane = 0;
+    while (Lane != LaneEnds.size() && LaneEnds[Lane] > I->Start)
+      ++Lane;
+    if (Lane == LaneEnds.size())
+      LaneEnds.push_back(I->End);
+    else
+      LaneEnds[Lane] = I->End;
+    I->Lane = Lane;
+  }
+
+  double Origin = Data.Start;
+  if (Origin == 0 && !Spans.empty())
+    Origin = Spans.front().Start;
+
+  OS << "{\n  \"traceEvents\" : [\n";
+  bool First = true;
+  for (std::vector<TraceSpan>::const_iterator I = Spans.begin(),
+                                              E = Spans.end();
+       I != E; ++I) {
+    double Start = I->Start - Origin;
+    if (I->Phase) {
+      writeTraceEvent(OS, First, I->Phase->Name, I->Phase->Transform, Start,
+                      I->End - I->Start, I->Lane);
+      continue;
+    }
+
+    const SourceProfile &Profile = I->Source->Profile;
+    writeTraceEvent(OS, First, I->Source->Source, I->Source->Transform, Start,
+                    I->End - I->Start, I->Lane);
+    double Parse = Profile.Parse.getWallTime();
+    writeTraceEvent(OS, First, "Parse", I->Source->Transform, Start, Parse,
+                    I->Lane);
+    writeTraceEvent(OS, First, "Match", I->Source->Transform, Start + Parse,
+                    Profile.Matching.getWallTime(), I->Lane);
+  }
+  OS << "\n  ],\n  \"displayTimeUnit\" : \"ms\"\n}\n";
+}
+
+void writeProfileSummary(llvm::raw_ostream &OS, const ProfileData &Data) {
+  OS << llvm::format("Run: wall %.2fms, user %.2fms, system %.2fms",
+                     Data.Total.getWallTime() * 1000.0,
+                     Data.Total.getUserTime() * 1000.0,
+                     Data.Total.getSystemTime() * 1000.0);
+  if (Data.PeakRSS)
+    OS << ", peak RSS " << Data.PeakRSS << " KiB";
+  OS << "\n";
+
+  // Transforms in the order they ran.
+  std::vector<std::string> Names;
+  for (unsigned I = 0, E = Data.Sources.size(); I != E; ++I)
+    if (std::find(Names.begin(), Names.end(), Data.Sources[I].Transform) ==
+        Names.end())
+      Names.push_back(Data.Sources[I].Transform);
+  for (unsigned I = 0, E = Data.Phases.size(); I != E; ++I)
+    if (std::find(Names.begin(), Names.end(), Data.Phases[I].Transform) ==
+        Names.end())
+      Names.push_back(Data.Phases[I].Transform);
+
+  for (std::vector<std::string>::const_iterator N = Names.begin(),
+                                                NE = Names.end();
+       N != NE; ++N) {
+    std::vector<double> Total, Parse, Match, Callbacks;
+    for (std::vector<ProfileData::SourceEntry>::const_iterator
+             I = Data.Sources.begin(),
+             E = Data.Sources.end();
+         I != E; ++I) {
+      if (I->Transform != *N)
+        continue;
+      const SourceProfile &Profile = I->Profile;
+      Total.push_back(Profile.Total.getWallTime());
+      Parse.push_back(Profile.Parse.getWallTime());
+      // Matching without the callbacks, which get their own row.
+      Match.push_back(Profile.Matching.getWallTime() - Profile.Callbacks);
+      Callbacks.push_back(Profile.Callbacks);
+    }
+    std::vector<double> Phases;
+    std::string PhaseName;
+    for (std::vector<ProfileData::PhaseEntry>::const_iterator
+             I = Data.Phases.begin(),
+             E = Data.Phases.end();
+         I != E; ++I) {
+      if (I->Transform != *N)
+        continue;
+      Phases.push_back(I->Time.getWallTime());
+      PhaseName = I->Name;
+    }
+
+    OS << "\n" << *N << ": " << Total.size() << " sources, wall time in ms\n";
+    OS << llvm::format("  %-12s%12s%12s%12s%12s%12s\n", "", "p50", "p90",
+                       "p99", "max", "total");
+    if (!Total.empty()) {
+      writeSummaryRow(OS, "Source", Total);
+      writeSummaryRow(OS, "Parse", Parse);
+      writeSummaryRow(OS, "Match", Match);
+      writeSummaryRow(OS, "Callbacks", Callbacks);
+    }
+    if (!Phases.empty())
+      writeSummaryRow(OS, PhaseName, Phases);
+
+    std::map<std::string, std::map<std::string, CallbackProfile> >::
+        const_iterator Callback = Data.Callbacks.find(*N);
+    if (Callback == Data.Callbacks.end())
+      continue;
+    OS << llvm::format("  %-24s%12s%12s%12s\n", "Callback", "count",
+                       "total ms", "mean us");
+    for (std::map<std::string, CallbackProfile>::const_iterator
+             I = Callback->second.begin(),
+             E = Callback->second.end();
+         I != E; ++I) {
+      const CallbackProfile &Profile = I->second;
+      OS << llvm::format("  %-24s%12u%12.2f%12.2f\n", I->first.c_str(),
+                         Profile.Count, Profile.WallTime * 1000.0,
+                         Profile.Count ? Profile.WallTime * 1e6 / Profile.Count
+                                       : 0.0);
+    }
+  }
+}
+
+void writeProfileData(const llvm::StringRef PerfDataPath,
+                      const ProfileData &Data) {
+  llvm::SmallString<128> TracePath(PerfDataPath);
+  llvm::sys::path::replace_extension(TracePath, "trace.json");
+  llvm::SmallString<128> SummaryPath(PerfDataPath);
+  llvm::sys::path::replace_extension(SummaryPath, "summary.txt");
+
+  std::string ErrorInfo;
+  llvm::raw_fd_ostream Trace(TracePath.c_str(), ErrorInfo);
+  if (ErrorInfo.empty())
+    writeChromeTrace(Trace, Data);
+  else
+    llvm::errs() << "Error writing " << TracePath << ": " << ErrorInfo << "\n";
+
+  ErrorInfo.clear();
+  llvm::raw_fd_ostream Summary(SummaryPath.c_str(), ErrorInfo);
+  if (ErrorInfo.empty())
+    writeProfileSummary(Summary, Data);
+  else
+    llvm::errs() << "Error writing " << SummaryPath << ": " << ErrorInfo
+                 << "\n";
+}
+
+uint64_t getPeakRSS() {
+#ifdef LLVM_ON_UNIX
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  // Darwin reports bytes, other systems KiB.
+  return Usage.ru_maxrss / 1024;
+#else
+  return Usage.ru_maxrss;
+#endif
+#else
+  return 0;
+#endif
 }
 
 void dumpPerfData(const SourcePerfData &Data) {
@@ -18,6 +18,7 @@
 
 #include "Transform.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <map>
 #include <vector>
@@ -44,13 +45,80 @@ extern void collectSourcePerfData(const Transform &T, SourcePerfData &Data);
 
 /// Write timing results to a JSON formatted file.
 ///
-/// File is placed in the directory given by \p DirectoryName. File is named in
-/// a unique way with time and process ID to avoid naming collisions with
-/// existing files or files being generated by other migrator processes.
-void writePerfDataJSON(
+/// File is placed in the directory given by \p DirectoryName. File is named
+/// after the current time with a random suffix, created atomically so that it
+/// never collides with existing files or files being generated by other
+/// migrator processes.
+///
+/// \returns The path of the file written, or an empty string on error.
+std::string writePerfDataJSON(
     const llvm::StringRef DirectoryName,
     const SourcePerfData &TimingResults);
 
+/// \brief Detailed performance data of a whole run.
+struct ProfileData {
+  ProfileData() : Start(0), PeakRSS(0) {}
+
+  /// \brief The SourceProfile of a transform for a source.
+  struct SourceEntry {
+    std::string Transform;
+    std::string Source;
+    SourceProfile Profile;
+  };
+
+  /// \brief A step of the run that does not belong to a source, such as
+  /// applying the replacements of a transform.
+  struct PhaseEntry {
+    std::string Transform;
+    std::string Name;
+    /// Wall-clock time, in seconds.
+    double Start;
+    llvm::TimeRecord Time;
+  };
+
+  std::vector<SourceEntry> Sources;
+  std::vector<PhaseEntry> Phases;
+
+  /// Runs of the profiled callbacks, keyed by transform name then label.
+  std::map<std::string, std::map<std::string, CallbackProfile> > Callbacks;
+
+  /// Wall-clock time the run began at, in seconds.
+  double Start;
+
+  /// The whole run.
+  llvm::TimeRecord Total;
+
+  /// Peak resident set size of the process, in KiB, or 0 if unknown.
+  uint64_t PeakRSS;
+};
+
+/// Extracts the profiles and callback runs collected by a Transform and adds
+/// them to \p Data.
+extern void collectProfileData(const Transform &T, ProfileData &Data);
+
+/// Write \p Data in the Trace Event Format read by Chrome's about:tracing.
+///
+/// Each source of each transform is a complete event containing its parse and
+/// match phases. Events that overlap in time, e.g. with -j, are put on
+/// separate threads of the trace.
+void writeChromeTrace(llvm::raw_ostream &OS, const ProfileData &Data);
+
+/// Write a human-readable summary of \p Data: the process times and peak RSS
+/// of the run, percentiles of each phase across the sources of each transform
+/// and the runs of each profiled callback.
+void writeProfileSummary(llvm::raw_ostream &OS, const ProfileData &Data);
+
+/// Write the Chrome trace and the summary of \p Data next to \p PerfDataPath,
+/// as returned by writePerfDataJSON(), replacing its extension with
+/// \c .trace.json and \c .summary.txt respectively.
+void writeProfileData(const llvm::StringRef PerfDataPath,
+                      const ProfileData &Data);
+
+/// Query the peak resident set size of the process, in KiB.
+///
+/// \returns 0 where the platform does not provide it.
+uint64_t getPeakRSS();
+
 /// Dump a SourcePerfData map to llvm::errs().
 extern void dumpPerfData(const SourcePerfData &Data);
 
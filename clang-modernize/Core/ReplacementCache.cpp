@@ -0,0 +1,284 @@
+//===-- Core/ReplacementCache.cpp - Per-TU replacement cache --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the definition of the ReplacementCache class
+/// which lets unchanged translation units skip a transform.
+///
+//===----------------------------------------------------------------------===//
+
+#include "Core/ReplacementCache.h"
+#include "Core/FileOverlay.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Tooling/ReplacementsYaml.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/system_error.h"
+
+using namespace clang;
+using namespace clang::tooling;
+
+namespace {
+
+typedef ReplacementCache::CachedUnit CachedUnit;
+
+/// \brief The cached results of a transform for one source.
+struct CacheEntry {
+  std::vector<CachedUnit> Units;
+};
+
+void hashString(llvm::MD5 &Hash, llvm::StringRef S) {
+  Hash.update(S);
+  // Separate consecutive strings so that "ab", "c" and "a", "bc" differ.
+  Hash.update(llvm::StringRef("", 1));
+}
+
+/// \brief PPCallbacks hashing the name and contents of every file entered by
+/// the preprocessor.
+class ContentHasher : public PPCallbacks {
+public:
+  ContentHasher(SourceManager &SM, llvm::MD5 &Hash) : SM(SM), Hash(Hash) {}
+
+  virtual void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                           SrcMgr::CharacteristicKind FileType,
+                           FileID PrevFID) LLVM_OVERRIDE {
+    if (Reason != EnterFile)
+      return;
+
+    FileID ID = SM.getFileID(Loc);
+    const FileEntry *Entry = SM.getFileEntryForID(ID);
+    // The predefines buffer only depends on the compile command.
+    if (!Entry)
+      return;
+
+    bool Invalid = false;
+    llvm::StringRef Contents = SM.getBufferData(ID, &Invalid);
+    hashString(Hash, Entry->getName());
+    hashString(Hash, Invalid ? llvm::StringRef() : Contents);
+  }
+
+private:
+  SourceManager &SM;
+  llvm::MD5 &Hash;
+};
+
+/// \brief FrontendAction preprocessing each translation unit to hash the files
+/// it is made of.
+class HashAction : public PreprocessorFrontendAction {
+public:
+  HashAction(llvm::MD5 &Hash, std::vector<std::string> &Units,
+             const FileOverlay *Overlay)
+      : Hash(Hash), Units(Units), Overlay(Overlay) {}
+
+protected:
+  virtual bool BeginInvocation(CompilerInstance &CI) LLVM_OVERRIDE {
+    if (Overlay)
+      Overlay->remapFiles(CI.getPreprocessorOpts());
+    return PreprocessorFrontendAction::BeginInvocation(CI);
+  }
+
+  virtual bool BeginSourceFileAction(CompilerInstance &CI,
+                                     llvm::StringRef Filename) LLVM_OVERRIDE {
+    // The transform reports the diagnostics of the source when it runs.
+    CI.getDiagnostics().setSuppressAllDiagnostics(true);
+    Units.push_back(Filename);
+    hashString(Hash, Filename);
+    return true;
+  }
+
+  virtual void ExecuteAction() LLVM_OVERRIDE {
+    CompilerInstance &CI = getCompilerInstance();
+    Preprocessor &PP = CI.getPreprocessor();
+    PP.addPPCallbacks(new ContentHasher(CI.getSourceManager(), Hash));
+
+    Token Tok;
+    PP.EnterMainSourceFile();
+    do
+      PP.Lex(Tok);
+    while (Tok.isNot(tok::eof));
+  }
+
+private:
+  llvm::MD5 &Hash;
+  std::vector<std::string> &Units;
+  const FileOverlay *Overlay;
+};
+
+class HashActionFactory : public FrontendActionFactory {
+public:
+  HashActionFactory(llvm::MD5 &Hash, std::vector<std::string> &Units,
+                    const FileOverlay *Overlay)
+      : Hash(Hash), Units(Units), Overlay(Overlay) {}
+
+  virtual FrontendAction *create() LLVM_OVERRIDE {
+    return new HashAction(Hash, Units, Overlay);
+  }
+
+private:
+  llvm::MD5 &Hash;
+  std::vector<std::string> &Units;
+  const FileOverlay *Overlay;
+};
+
+} // namespace
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(ReplacementCache::CachedUnit)
+LLVM_YAML_IS_SEQUENCE_VECTOR(std::string)
+
+namespace llvm {
+namespace yaml {
+
+template <> struct MappingTraits<ReplacementCache::CachedUnit> {
+  static void mapping(IO &Io, ReplacementCache::CachedUnit &U) {
+    Io.mapRequired("MainSourceFile", U.MainSourceFile);
+    Io.mapRequired("Accepted", U.Counts.Accepted);
+    Io.mapRequired("Rejected", U.Counts.Rejected);
+    Io.mapRequired("Deferred", U.Counts.Deferred);
+    Io.mapOptional("Replacements", U.Replacements);
+  }
+};
+
+template <> struct MappingTraits<CacheEntry> {
+  static void mapping(IO &Io, CacheEntry &E) {
+    Io.mapRequired("Units", E.Units);
+  }
+};
+
+} // end namespace yaml
+} // end namespace llvm
+
+void ReplacementCache::lookup(const Transform &T,
+                              const CompilationDatabase &Database,
+                              const std::vector<std::string> &SourcePaths,
+                              std::vector<std::string> &Misses) {
+  PendingKeys.clear();
+  Hits.clear();
+  for (std::vector<std::string>::const_iterator I = SourcePaths.begin(),
+                                                E = SourcePaths.end();
+       I != E; ++I) {
+    SourceKey Key;
+    if (!computeKey(T, Database, *I, Key)) {
+      Misses.push_back(*I);
+      continue;
+    }
+
+    llvm::OwningPtr<llvm::MemoryBuffer> Buffer;
+    CacheEntry Entry;
+    if (!llvm::MemoryBuffer::getFile(getEntryPath(Key.Key), Buffer)) {
+      llvm::yaml::Input YIn(Buffer->getBuffer());
+      YIn >> Entry;
+      if (YIn.error())
+        Entry.Units.clear();
+    }
+    if (Entry.Units.size() != Key.Units.size()) {
+      Misses.push_back(*I);
+      PendingKeys.push_back(Key);
+      continue;
+    }
+
+    Hits.insert(Hits.end(), Entry.Units.begin(), Entry.Units.end());
+  }
+}
+
+void ReplacementCache::store(const Transform &T) {
+  for (std::vector<SourceKey>::const_iterator I = PendingKeys.begin(),
+                                              E = PendingKeys.end();
+       I != E; ++I) {
+    CacheEntry Entry;
+    for (std::vector<std::string>::const_iterator U = I->Units.begin(),
+                                                  UE = I->Units.end();
+         U != UE; ++U) {
+      CachedUnit Unit;
+      Unit.MainSourceFile = *U;
+      Unit.Counts = T.getSourceChangeCounts().lookup(*U);
+      Unit.Replacements = T.getAllReplacements().lookup(*U).Replacements;
+      Entry.Units.push_back(Unit);
+    }
+
+    // Write to a temporary file first so that a concurrent or interrupted run
+    // never sees a partial entry.
+    std::string Path = getEntryPath(I->Key);
+    std::string TempPath = Path + ".tmp";
+    std::string ErrorInfo;
+    {
+      llvm::raw_fd_ostream EntryFile(TempPath.c_str(), ErrorInfo,
+                                     llvm::sys::fs::F_Binary);
+      if (!ErrorInfo.empty()) {
+        llvm::errs() << "Error opening cache entry: " << ErrorInfo << "\n";
+        continue;
+      }
+      llvm::yaml::Output YAML(EntryFile);
+      YAML << Entry;
+    }
+    if (llvm::error_code EC = llvm::sys::fs::rename(TempPath, Path))
+      llvm::errs() << "Error writing cache entry " << Path << ": "
+                   << EC.message() << "\n";
+  }
+  PendingKeys.clear();
+}
+
+void ReplacementCache::restore(Transform &T) {
+  for (std::vector<CachedUnit>::const_iterator I = Hits.begin(),
+                                               E = Hits.end();
+       I != E; ++I)
+    T.addSourceResults(I->MainSourceFile, I->Counts, I->Replacements);
+  Hits.clear();
+}
+
+bool ReplacementCache::computeKey(const Transform &T,
+                                  const CompilationDatabase &Database,
+                                  const std::string &SourcePath,
+                                  SourceKey &Result) const {
+  llvm::MD5 Hash;
+  hashString(Hash, CLANG_VERSION_STRING);
+  hashString(Hash, Configuration);
+  hashString(Hash, T.getName());
+  hashString(Hash, T.describeOptions());
+
+  llvm::SmallString<128> AbsolutePath(SourcePath);
+  llvm::sys::fs::make_absolute(AbsolutePath);
+  std::vector<CompileCommand> Commands =
+      Database.getCompileCommands(AbsolutePath.str());
+  for (std::vector<CompileCommand>::const_iterator I = Commands.begin(),
+                                                   E = Commands.end();
+       I != E; ++I) {
+    hashString(Hash, I->Directory);
+    for (std::vector<std::string>::const_iterator A = I->CommandLine.begin(),
+                                                  AE = I->CommandLine.end();
+         A != AE; ++A)
+      hashString(Hash, *A);
+  }
+
+  ClangTool Tool(Database, std::vector<std::string>(1, SourcePath));
+  HashActionFactory Factory(Hash, Result.Units, Overlay);
+  if (Tool.run(&Factory) != 0 || Result.Units.empty())
+    return false;
+
+  llvm::MD5::MD5Result Digest;
+  Hash.final(Digest);
+  llvm::SmallString<32> Key;
+  llvm::MD5::stringifyResult(Digest, Key);
+  Result.Key = Key.str();
+  return true;
+}
+
+std::string ReplacementCache::getEntryPath(llvm::StringRef Key) const {
+  llvm::SmallString<128> Path(Directory);
+  llvm::sys::path::append(Path, Key + ".yaml");
+  return Path.str();
+}
@@ -0,0 +1,104 @@
+//===-- Core/ReplacementCache.h - Per-TU replacement cache ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the declaration of the ReplacementCache class
+/// which lets unchanged translation units skip a transform.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_MODERNIZE_REPLACEMENT_CACHE_H
+#define CLANG_MODERNIZE_REPLACEMENT_CACHE_H
+
+#include "Core/Transform.h"
+#include <string>
+#include <vector>
+
+class FileOverlay;
+
+/// \brief Cache of the results of transforms, one entry per transform and
+/// source, stored in a directory.
+///
+/// An entry holds the replacements and change counts of every translation
+/// unit built from the source. It is keyed by a hash of:
+/// \li the contents of every file the preprocessor enters for the source,
+/// \li the compile commands of the source,
+/// \li the name and options of the transform (see
+///     Transform::describeOptions()),
+/// \li the configuration given to the constructor.
+///
+/// Computing the key only preprocesses the source, which is much cheaper than
+/// parsing it and running the matchers of the transform.
+class ReplacementCache {
+public:
+  /// \brief The cached results of a transform for one translation unit.
+  struct CachedUnit {
+    std::string MainSourceFile;
+    ChangeCounts Counts;
+    std::vector<clang::tooling::Replacement> Replacements;
+  };
+
+  /// \param Directory Existing directory holding the cache entries.
+  /// \param Configuration Description of the options affecting the results of
+  /// all transforms, such as the risk level and include/exclude lists.
+  /// \param Overlay Files the transforms parse from memory instead of disk,
+  /// or null.
+  ReplacementCache(llvm::StringRef Directory, llvm::StringRef Configuration,
+                   const FileOverlay *Overlay = 0)
+      : Directory(Directory), Configuration(Configuration), Overlay(Overlay) {}
+
+  /// \brief Load the cached results of \p T for the sources in
+  /// \p SourcePaths and collect the sources without results in \p Misses.
+  ///
+  /// Must be called before \p T is applied to \p Misses since it hashes the
+  /// sources as \p T will see them.
+  void lookup(const Transform &T,
+              const clang::tooling::CompilationDatabase &Database,
+              const std::vector<std::string> &SourcePaths,
+              std::vector<std::string> &Misses);
+
+  /// \brief Store the results of \p T for the misses of the last call to
+  /// lookup().
+  ///
+  /// Entries that cannot be written are reported and skipped; the sources
+  /// will simply be transformed again by the next run.
+  void store(const Transform &T);
+
+  /// \brief Add the results loaded by the last call to lookup() to \p T.
+  ///
+  /// Must be called after \p T is applied since Transform::apply() discards
+  /// earlier results.
+  void restore(Transform &T);
+
+private:
+  struct SourceKey {
+    std::string Key;
+    /// Main source file of each translation unit built from the source.
+    std::vector<std::string> Units;
+  };
+
+  /// \brief Compute the key of the results of \p T for \p SourcePath.
+  ///
+  /// \returns \li true on success
+  ///          \li false if \p SourcePath could not be preprocessed
+  bool computeKey(const Transform &T,
+                  const clang::tooling::CompilationDatabase &Database,
+                  const std::string &SourcePath, SourceKey &Result) const;
+
+  /// \brief Path of the entry named \p Key.
+  std::string getEntryPath(llvm::StringRef Key) const;
+
+  const std::string Directory;
+  const std::string Configuration;
+  const FileOverlay *Overlay;
+  std::vector<SourceKey> PendingKeys;
+  std::vector<CachedUnit> Hits;
+};
+
+#endif // CLANG_MODERNIZE_REPLACEMENT_CACHE_H
@@ -13,33 +13,23 @@
 //===----------------------------------------------------------------------===//
 
 #include "Core/ReplacementHandling.h"
+#include "Core/FileOverlay.h"
+#include "clang-apply-replacements/Tooling/ApplyReplacements.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Format/Format.h"
 #include "clang/Tooling/ReplacementsYaml.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
-#include "llvm/Support/Program.h"
 #include "llvm/Support/system_error.h"
 
 using namespace llvm;
 using namespace llvm::sys;
 using namespace clang::tooling;
 
-bool ReplacementHandling::findClangApplyReplacements(const char *Argv0) {
-  CARPath = FindProgramByName("clang-apply-replacements");
-
-  if (!CARPath.empty())
-    return true;
-
-  static int StaticSymbol;
-  CARPath = fs::getMainExecutable(Argv0, &StaticSymbol);
-  SmallString<128> TestPath = path::parent_path(CARPath);
-  path::append(TestPath, "clang-apply-replacements");
-  if (fs::can_execute(Twine(TestPath)))
-    CARPath = TestPath.str();
-
-  return !CARPath.empty();
-}
-
 StringRef ReplacementHandling::useTempDestinationDir() {
   DestinationDir = generateTempDir();
   return DestinationDir;
@@ -86,46 +76,56 @@ bool ReplacementHandling::serializeReplacements(
   return !Errors;
 }
 
-bool ReplacementHandling::applyReplacements() {
-  SmallVector<const char *, 8> Argv;
-  Argv.push_back(CARPath.c_str());
-  std::string Style = "--style=" + FormatStyle;
-  std::string StyleConfig = "--style-config=" + StyleConfigDir;
-  if (DoFormat) {
-    Argv.push_back("--format");
-    Argv.push_back(Style.c_str());
-    if (!StyleConfigDir.empty())
-      Argv.push_back(StyleConfig.c_str());
-  }
-  Argv.push_back("--remove-change-desc-files");
-  Argv.push_back(DestinationDir.c_str());
-
-  // Argv array needs to be null terminated.
-  Argv.push_back(0);
-
-  std::string ErrorMsg;
-  bool ExecutionFailed = false;
-  int ReturnCode = ExecuteAndWait(CARPath.c_str(), Argv.data(), /* env */ 0,
-                                  /* redirects */ 0,
-                                  /* secondsToWait */ 0, /* memoryLimit */ 0,
-                                  &ErrorMsg, &ExecutionFailed);
-  if (ExecutionFailed || !ErrorMsg.empty()) {
-    errs() << "Failed to launch clang-apply-replacements: " << ErrorMsg << "\n";
-    errs() << "Command Line:\n";
-    for (const char **I = Argv.begin(), **E = Argv.end(); I != E; ++I) {
-      if (*I)
-        errs() << *I << "\n";
+bool
+ReplacementHandling::applyReplacements(const TUReplacementsMap &Replacements) {
+  clang::replace::TUReplacements TUs;
+  for (TUReplacementsMap::const_iterator I = Replacements.begin(),
+                                         E = Replacements.end();
+       I != E; ++I) {
+    TUs.push_back(I->getValue());
+    if (!Overlay)
+      continue;
+
+    // The overlay is keyed by canonical path.
+    std::vector<Replacement> &Rs = TUs.back().Replacements;
+    for (std::vector<Replacement>::iterator R = Rs.begin(), RE = Rs.end();
+         R != RE; ++R) {
+      SmallString<128> FilePath(R->getFilePath());
+      FileOverlay::makeCanonical(FilePath);
+      *R = Replacement(FilePath.str(), R->getOffset(), R->getLength(),
+                       R->getReplacementText());
     }
-    return false;
   }
 
-  if (ReturnCode != 0) {
-    errs() << "clang-apply-replacements failed with return code " << ReturnCode
-           << "\n";
+  IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts(
+      new clang::DiagnosticOptions());
+  clang::DiagnosticsEngine Diagnostics(
+      IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs()),
+      DiagOpts.getPtr());
+  clang::FileManager Files((clang::FileSystemOptions()));
+  clang::SourceManager SM(Diagnostics, Files);
+  // Conflicts are reported with the contents the replacements were made for.
+  if (Overlay)
+    for (FileOverlay::const_iterator I = Overlay->begin(), E = Overlay->end();
+         I != E; ++I)
+      if (const clang::FileEntry *Entry = Files.getFile(I->getKey()))
+        SM.overrideFileContents(
+            Entry, MemoryBuffer::getMemBuffer(I->getValue(), I->getKey()));
+
+  clang::replace::FileToReplacementsMap GroupedReplacements;
+  if (!clang::replace::mergeAndDeduplicate(TUs, GroupedReplacements, SM))
     return false;
-  }
 
-  return true;
+  clang::format::FormatStyle Style;
+  if (DoFormat)
+    Style = clang::format::getStyle(FormatStyle, StyleConfigDir);
+
+  if (Overlay)
+    return clang::replace::rewriteFileContents(
+        GroupedReplacements, DoFormat ? &Style : 0, Diagnostics,
+        Overlay->getFiles());
+  return clang::replace::rewriteFiles(GroupedReplacements,
+                                      DoFormat ? &Style : 0, Diagnostics);
 }
 
 std::string ReplacementHandling::generateTempDir() {
@@ -9,7 +9,7 @@
 ///
 /// \file
 /// \brief This file defines the ReplacementHandling class which abstracts
-/// serialization and application of serialized replacements.
+/// serialization and application of replacements.
 ///
 //===----------------------------------------------------------------------===//
 
@@ -19,21 +19,12 @@
 #include "llvm/ADT/StringRef.h"
 #include "Core/Transform.h"
 
+class FileOverlay;
+
 class ReplacementHandling {
 public:
 
-  ReplacementHandling() : DoFormat(false) {}
-
-  /// \brief Finds the path to the executable 'clang-apply-replacements'.
-  ///
-  /// The executable is searched for on the PATH. If not found, looks in the
-  /// same directory as the image used to start the current executable.
-  ///
-  /// \param[in] Argv0 argv[0] as passed to main().
-  ///
-  /// \returns \li true if clang-apply-replacements was found.
-  ///          \li false otherwise.
-  bool findClangApplyReplacements(const char *Argv0);
+  ReplacementHandling() : DoFormat(false), Overlay(0) {}
 
   /// \brief Set the name of the directory in which replacements will be
   /// serialized.
@@ -46,13 +37,13 @@ public:
   /// \returns The name of the directory createdy.
   llvm::StringRef useTempDestinationDir();
 
-  /// \brief Enable clang-apply-replacements do code reformatting when applying
-  /// serialized replacements.
+  /// \brief Enable code reformatting of the changed code when applying
+  /// replacements.
   ///
-  /// \param[in] Style Value to pass to clang-apply-replacement's --style
-  /// option.
-  /// \param[in] StyleConfigDir If non-empty, value to pass to
-  /// clang-apply-replacement's --style-config option.
+  /// \param[in] Style Style to reformat with, as for clang-apply-replacement's
+  /// --style option.
+  /// \param[in] StyleConfigDir If non-empty, directory to look for the style
+  /// configuration in, as for clang-apply-replacement's --style-config option.
   void enableFormatting(llvm::StringRef Style,
                         llvm::StringRef StyleConfigDir = "");
 
@@ -70,16 +61,22 @@ public:
   ///          \li false otherwise.
   bool serializeReplacements(const TUReplacementsMap &Replacements);
 
-  /// \brief Invoke clang-apply-replacements to apply all serialized
-  /// replacements stored in the destination directory.
+  /// \brief Keep the new contents of the files changed by applyReplacements()
+  /// in \p Overlay instead of writing them to disk.
+  void setOverlay(FileOverlay *Overlay) { this->Overlay = Overlay; }
+
+  /// \brief Apply \p Replacements to the files on disk in-process.
   ///
-  /// \pre Destination directory must have been previously set by calling
-  /// setDestiantionDir() or useTempDestinationDir().
+  /// Replacements are merged, deduplicated, checked for conflicts and
+  /// reformatted (see enableFormatting()) with the clangApplyReplacements
+  /// library, exactly as clang-apply-replacements would, but without
+  /// serializing them or launching a process. With an overlay (see
+  /// setOverlay()), files are read from and written to the overlay instead.
   ///
-  /// \returns \li true if clang-apply-replacements was successfully launched
-  ///          and successfully completed.
+  /// \returns \li true if all replacements were applied and all changed files
+  ///          were written.
   ///          \li false otherwise.
-  bool applyReplacements();
+  bool applyReplacements(const TUReplacementsMap &Replacements);
 
   /// \brief Generate a unique filename to store the replacements.
   ///
@@ -113,11 +110,11 @@ public:
 
 private:
 
-  std::string CARPath;
   std::string DestinationDir;
   bool DoFormat;
   std::string FormatStyle;
   std::string StyleConfigDir;
+  FileOverlay *Overlay;
 };
 
 #endif // CLANG_MODERNIZE_REPLACEMENTHANDLING_H
@@ -14,12 +14,21 @@
 //===----------------------------------------------------------------------===//
 
 #include "Core/Transform.h"
+#include "Core/FileOverlay.h"
+#include "Core/PerfSupport.h"
+#include "clang/AST/ASTConsumer.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Basic/LangOptions.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/TimeValue.h"
 
 using namespace clang;
 
@@ -30,25 +39,51 @@ namespace {
 using namespace tooling;
 using namespace ast_matchers;
 
+/// \brief ASTConsumer running the matchers of a MatchFinder and telling a
+/// Transform when they start and stop.
+class MatchingConsumer : public ASTConsumer {
+public:
+  MatchingConsumer(MatchFinder &Finder, Transform &Owner)
+      : Finder(Finder), Owner(Owner) {}
+
+  virtual void HandleTranslationUnit(ASTContext &Context) LLVM_OVERRIDE {
+    Owner.handleBeginMatching();
+    Finder.matchAST(Context);
+    Owner.handleEndMatching();
+  }
+
+private:
+  MatchFinder &Finder;
+  Transform &Owner;
+};
+
 /// \brief Custom FrontendActionFactory to produce FrontendActions that simply
 /// forward (Begin|End)SourceFileAction calls to a given Transform.
 class ActionFactory : public clang::tooling::FrontendActionFactory {
 public:
-  ActionFactory(MatchFinder &Finder, Transform &Owner)
-  : Finder(Finder), Owner(Owner) {}
+  ActionFactory(MatchFinder &Finder, Transform &Owner,
+                const FileOverlay *Overlay)
+      : Finder(Finder), Owner(Owner), Overlay(Overlay) {}
 
   virtual FrontendAction *create() LLVM_OVERRIDE {
-    return new FactoryAdaptor(Finder, Owner);
+    return new FactoryAdaptor(Finder, Owner, Overlay);
   }
 
 private:
   class FactoryAdaptor : public ASTFrontendAction {
   public:
-    FactoryAdaptor(MatchFinder &Finder, Transform &Owner)
-        : Finder(Finder), Owner(Owner) {}
+    FactoryAdaptor(MatchFinder &Finder, Transform &Owner,
+                   const FileOverlay *Overlay)
+        : Finder(Finder), Owner(Owner), Overlay(Overlay) {}
 
     ASTConsumer *CreateASTConsumer(CompilerInstance &, StringRef) {
-      return Finder.newASTConsumer();
+      return new MatchingConsumer(Finder, Owner);
+    }
+
+    virtual bool BeginInvocation(CompilerInstance &CI) LLVM_OVERRIDE {
+      if (Overlay)
+        Overlay->remapFiles(CI.getPreprocessorOpts());
+      return ASTFrontendAction::BeginInvocation(CI);
     }
 
     virtual bool BeginSourceFileAction(CompilerInstance &CI,
@@ -67,52 +102,293 @@ private:
   private:
     MatchFinder &Finder;
     Transform &Owner;
+    const FileOverlay *Overlay;
   };
 
   MatchFinder &Finder;
   Transform &Owner;
+  const FileOverlay *Overlay;
 };
+
+/// \brief PPCallbacks recording the offsets of the ranges skipped by
+/// conditional directives in each file.
+class SkippedRangeRecorder : public PPCallbacks {
+public:
+  SkippedRangeRecorder(
+      const SourceManager &SM,
+      llvm::DenseMap<FileID, std::vector<unsigned> > &SkippedRanges)
+      : SM(SM), SkippedRanges(SkippedRanges) {}
+
+  virtual void SourceRangeSkipped(SourceRange Range) LLVM_OVERRIDE {
+    std::pair<FileID, unsigned> Begin = SM.getDecomposedLoc(Range.getBegin());
+    std::vector<unsigned> &Offsets = SkippedRanges[Begin.first];
+    Offsets.push_back(Begin.second);
+    Offsets.push_back(SM.getFileOffset(Range.getEnd()));
+  }
+
+private:
+  const SourceManager &SM;
+  llvm::DenseMap<FileID, std::vector<unsigned> > &SkippedRanges;
+};
+/// \brief Current wall-clock time in seconds. Cheaper than
+/// TimeRecord::getCurrentTime(), which also queries the process usage.
+double getWallTime() {
+  llvm::sys::TimeValue Now = llvm::sys::TimeValue::now();
+  return Now.seconds() + Now.nanoseconds() * 1e-9;
+}
 } // namespace
 
+/// \brief MatchCallback counting and timing the runs of another one for a
+/// transform (see Transform::profileCallback()).
+class ProfiledCallback : public MatchFinder::MatchCallback {
+public:
+  ProfiledCallback(Transform &Owner, StringRef Label)
+      : Owner(Owner), Label(Label), Callback(0) {}
+
+  void setCallback(MatchFinder::MatchCallback *Callback) {
+    this->Callback = Callback;
+  }
+
+  virtual void run(const MatchFinder::MatchResult &Result) LLVM_OVERRIDE {
+    double Begin = getWallTime();
+    Callback->run(Result);
+    Owner.addCallbackTime(Label, getWallTime() - Begin);
+  }
+
+private:
+  Transform &Owner;
+  const std::string Label;
+  MatchFinder::MatchCallback *Callback;
+};
+
+bool TransformedHeaders::claim(StringRef Key) {
+  llvm::MutexGuard Guard(Lock);
+  return Keys.insert(Key);
+}
+
+bool TransformedHeaders::contains(StringRef Key) {
+  llvm::MutexGuard Guard(Lock);
+  return Keys.count(Key);
+}
+
+void TransformedHeaders::clear() {
+  llvm::MutexGuard Guard(Lock);
+  Keys.clear();
+}
+
 Transform::Transform(llvm::StringRef Name, const TransformOptions &Options)
-    : Name(Name), GlobalOptions(Options) {
+    : Name(Name), GlobalOptions(Options), Headers(&OwnHeaders),
+      HeaderSkipping(true) {
   Reset();
 }
 
-Transform::~Transform() {}
+Transform::~Transform() {
+  for (llvm::StringMap<ProfiledCallback *>::iterator
+           I = ProfiledCallbacks.begin(),
+           E = ProfiledCallbacks.end();
+       I != E; ++I)
+    delete I->getValue();
+}
 
 bool Transform::isFileModifiable(const SourceManager &SM,
                                  const SourceLocation &Loc) const {
   if (SM.isWrittenInMainFile(Loc))
     return true;
 
-  const FileEntry *FE = SM.getFileEntryForID(SM.getFileID(Loc));
+  FileID ID = SM.getFileID(Loc);
+  const FileEntry *FE = SM.getFileEntryForID(ID);
   if (!FE)
     return false;
 
-  return GlobalOptions.ModifiableFiles.isFileIncluded(FE->getName());
+  if (!isFileIncluded(ID, FE))
+    return false;
+
+  return !isHeaderTransformed(SM, ID, FE);
+}
+
+bool Transform::canModifyFile(const SourceManager &SM,
+                              const SourceLocation &Loc) const {
+  if (SM.isWrittenInMainFile(Loc))
+    return true;
+
+  FileID ID = SM.getFileID(Loc);
+  const FileEntry *FE = SM.getFileEntryForID(ID);
+  if (!FE)
+    return false;
+
+  return isFileIncluded(ID, FE);
+}
+
+bool Transform::isFileIncluded(FileID ID, const FileEntry *Entry) const {
+  // FileIDs only identify files within the SourceManager of the current
+  // translation unit.
+  if (CurrentSource.empty())
+    return GlobalOptions.ModifiableFiles.isFileIncluded(Entry->getName());
+
+  llvm::DenseMap<FileID, bool>::const_iterator I = FileIncluded.find(ID);
+  if (I != FileIncluded.end())
+    return I->second;
+
+  bool Included =
+      GlobalOptions.ModifiableFiles.isFileIncluded(Entry->getName());
+  FileIncluded[ID] = Included;
+  return Included;
+}
+
+bool Transform::isHeaderTransformed(const SourceManager &SM, FileID ID,
+                                    const FileEntry *Entry) const {
+  // Outside of a translation unit run through handleBeginSource() there is
+  // nothing to remember the header for.
+  if (!GlobalOptions.SkipTransformedHeaders || !HeaderSkipping ||
+      CurrentSource.empty())
+    return false;
+
+  llvm::DenseMap<FileID, bool>::const_iterator I = HeaderTransformed.find(ID);
+  if (I != HeaderTransformed.end())
+    return I->second;
+
+  bool Invalid = false;
+  StringRef Contents = SM.getBufferData(ID, &Invalid);
+  if (Invalid) {
+    HeaderTransformed[ID] = false;
+    return false;
+  }
+
+  llvm::MD5 Hash;
+  Hash.update(Contents);
+  llvm::DenseMap<FileID, std::vector<unsigned> >::const_iterator Skipped =
+      SkippedRanges.find(ID);
+  if (Skipped != SkippedRanges.end() && !Skipped->second.empty()) {
+    const std::vector<unsigned> &Offsets = Skipped->second;
+    Hash.update(llvm::ArrayRef<uint8_t>(
+        reinterpret_cast<const uint8_t *>(&Offsets[0]),
+        Offsets.size() * sizeof(unsigned)));
+  }
+  llvm::MD5::MD5Result Digest;
+  Hash.final(Digest);
+  llvm::SmallString<32> DigestStr;
+  llvm::MD5::stringifyResult(Digest, DigestStr);
+  std::string Key = Entry->getName();
+  Key += ':';
+  Key += DigestStr.str();
+
+  bool Transformed = Headers->contains(Key);
+  if (!Transformed)
+    UnchangedHeaders[Entry->getName()].push_back(Key);
+  HeaderTransformed[ID] = Transformed;
+  return Transformed;
 }
 
 bool Transform::handleBeginSource(CompilerInstance &CI, StringRef Filename) {
   CurrentSource = Filename;
+  FileIncluded.clear();
+  HeaderTransformed.clear();
+  UnchangedHeaders.clear();
+  SkippedRanges.clear();
+  if (GlobalOptions.SkipTransformedHeaders && HeaderSkipping)
+    CI.getPreprocessor().addPPCallbacks(
+        new SkippedRangeRecorder(CI.getSourceManager(), SkippedRanges));
+
+  CountsAtBegin.Accepted = AcceptedChanges;
+  CountsAtBegin.Rejected = RejectedChanges;
+  CountsAtBegin.Deferred = DeferredChanges;
 
   if (Options().EnableTiming) {
+    llvm::TimeRecord Now = llvm::TimeRecord::getCurrentTime(true);
     Timings.push_back(std::make_pair(Filename.str(), llvm::TimeRecord()));
-    Timings.back().second -= llvm::TimeRecord::getCurrentTime(true);
+    Timings.back().second -= Now;
+    CurrentProfile = SourceProfile();
+    CurrentProfile.Start = Now.getWallTime();
+    CurrentProfile.Parse -= Now;
   }
   return true;
 }
 
+void Transform::handleBeginMatching() {
+  if (!Options().EnableTiming)
+    return;
+  llvm::TimeRecord Now = llvm::TimeRecord::getCurrentTime(true);
+  CurrentProfile.Parse += Now;
+  CurrentProfile.Matching -= Now;
+}
+
+void Transform::handleEndMatching() {
+  if (Options().EnableTiming)
+    CurrentProfile.Matching += llvm::TimeRecord::getCurrentTime(false);
+}
+
 void Transform::handleEndSource() {
+  ChangeCounts &Counts = SourceCounts[CurrentSource];
+  Counts.Accepted += AcceptedChanges - CountsAtBegin.Accepted;
+  Counts.Rejected += RejectedChanges - CountsAtBegin.Rejected;
+  Counts.Deferred += DeferredChanges - CountsAtBegin.Deferred;
+
+  if (Options().EnableTiming) {
+    llvm::TimeRecord Now = llvm::TimeRecord::getCurrentTime(false);
+    Timings.back().second += Now;
+    // The matchers do not run on translation units that failed to parse.
+    if (CurrentProfile.Parse.getWallTime() < 0)
+      CurrentProfile.Parse += Now;
+    CurrentProfile.Total = Timings.back().second;
+    CurrentProfile.PeakRSS = getPeakRSS();
+    Profiles.push_back(std::make_pair(CurrentSource, CurrentProfile));
+  }
+
+  // Headers are only marked once changed: a translation unit without changes
+  // in a header, e.g. because it does not instantiate a template defined
+  // there, must not hide the changes of the next ones.
+  TUReplacementsMap::const_iterator TU = Replacements.find(CurrentSource);
+  if (TU != Replacements.end() && !UnchangedHeaders.empty()) {
+    const std::vector<Replacement> &TUReplacements =
+        TU->getValue().Replacements;
+    for (std::vector<Replacement>::const_iterator I = TUReplacements.begin(),
+                                                  E = TUReplacements.end();
+         I != E; ++I) {
+      llvm::StringMap<std::vector<std::string> >::iterator Header =
+          UnchangedHeaders.find(I->getFilePath());
+      if (Header == UnchangedHeaders.end())
+        continue;
+      for (std::vector<std::string>::const_iterator
+               K = Header->getValue().begin(),
+               KE = Header->getValue().end();
+           K != KE; ++K)
+        Headers->claim(*K);
+      UnchangedHeaders.erase(Header);
+    }
+  }
+
   CurrentSource.clear();
-  if (Options().EnableTiming)
-    Timings.back().second += llvm::TimeRecord::getCurrentTime(false);
+  FileIncluded.clear();
+  HeaderTransformed.clear();
+  UnchangedHeaders.clear();
+  SkippedRanges.clear();
 }
 
 void Transform::addTiming(llvm::StringRef Label, llvm::TimeRecord Duration) {
   Timings.push_back(std::make_pair(Label.str(), Duration));
 }
 
+MatchFinder::MatchCallback *
+Transform::profileCallback(MatchFinder::MatchCallback *Callback,
+                           StringRef Label) {
+  if (!Options().EnableTiming)
+    return Callback;
+
+  // Wrappers are reused by later calls to registerMatchers().
+  ProfiledCallback *&Wrapper = ProfiledCallbacks[Label];
+  if (!Wrapper)
+    Wrapper = new ProfiledCallback(*this, Label);
+  Wrapper->setCallback(Callback);
+  return Wrapper;
+}
+
+void Transform::addCallbackTime(StringRef Label, double WallTime) {
+  CallbackProfile &Profile = CallbackProfiles[Label];
+  ++Profile.Count;
+  Profile.WallTime += WallTime;
+  CurrentProfile.Callbacks += WallTime;
+}
+
 bool
 Transform::addReplacementForCurrentTU(const clang::tooling::Replacement &R) {
   if (CurrentSource.empty())
@@ -126,8 +402,62 @@ Transform::addReplacementForCurrentTU(const clang::tooling::Replacement &R) {
   return true;
 }
 
+void Transform::addSourceResults(
+    StringRef Source, const ChangeCounts &Counts,
+    const std::vector<tooling::Replacement> &SourceReplacements) {
+  AcceptedChanges += Counts.Accepted;
+  RejectedChanges += Counts.Rejected;
+  DeferredChanges += Counts.Deferred;
+  SourceCounts[Source] += Counts;
+
+  if (SourceReplacements.empty())
+    return;
+  TranslationUnitReplacements &TU = Replacements[Source];
+  if (TU.MainSourceFile.empty())
+    TU.MainSourceFile = Source;
+  TU.Replacements.insert(TU.Replacements.end(), SourceReplacements.begin(),
+                         SourceReplacements.end());
+}
+
+void Transform::takeResults(Transform &Other) {
+  AcceptedChanges += Other.AcceptedChanges;
+  RejectedChanges += Other.RejectedChanges;
+  DeferredChanges += Other.DeferredChanges;
+
+  for (TUReplacementsMap::const_iterator I = Other.Replacements.begin(),
+                                         E = Other.Replacements.end();
+       I != E; ++I) {
+    TranslationUnitReplacements &TU = Replacements[I->getKey()];
+    if (TU.MainSourceFile.empty())
+      TU.MainSourceFile = I->getValue().MainSourceFile;
+    TU.Replacements.insert(TU.Replacements.end(),
+                           I->getValue().Replacements.begin(),
+                           I->getValue().Replacements.end());
+  }
+
+  for (llvm::StringMap<ChangeCounts>::const_iterator
+           I = Other.SourceCounts.begin(),
+           E = Other.SourceCounts.end();
+       I != E; ++I)
+    SourceCounts[I->getKey()] += I->getValue();
+
+  Timings.insert(Timings.end(), Other.Timings.begin(), Other.Timings.end());
+  Profiles.insert(Profiles.end(), Other.Profiles.begin(), Other.Profiles.end());
+  for (llvm::StringMap<CallbackProfile>::const_iterator
+           I = Other.CallbackProfiles.begin(),
+           E = Other.CallbackProfiles.end();
+       I != E; ++I) {
+    CallbackProfile &Profile = CallbackProfiles[I->getKey()];
+    Profile.Count += I->getValue().Count;
+    Profile.WallTime += I->getValue().WallTime;
+  }
+
+  Other.Reset();
+  Other.clearPerfData();
+}
+
 FrontendActionFactory *Transform::createActionFactory(MatchFinder &Finder) {
-  return new ActionFactory(Finder, /*Owner=*/ *this);
+  return new ActionFactory(Finder, /*Owner=*/ *this, Options().Overlay);
 }
 
 Version Version::getFromString(llvm::StringRef VersionStr) {
@@ -18,8 +18,13 @@
 
 #include "Core/IncludeExcludeInfo.h"
 #include "Core/Refactoring.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/SourceLocation.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/Registry.h"
 #include "llvm/Support/Timer.h"
 #include <string>
@@ -45,11 +50,11 @@ namespace tooling {
 class CompilationDatabase;
 class FrontendActionFactory;
 } // namespace tooling
-namespace ast_matchers {
-class MatchFinder;
-} // namespace ast_matchers
 } // namespace clang
 
+class FileOverlay;
+class ProfiledCallback;
+
 // \brief Maps main source file names to a TranslationUnitReplacements
 // structure storing replacements for that translation unit.
 typedef llvm::StringMap<clang::tooling::TranslationUnitReplacements>
@@ -60,6 +65,10 @@ extern llvm::cl::OptionCategory TransformsOptionsCategory;
 
 /// \brief Container for global options affecting all transforms.
 struct TransformOptions {
+  TransformOptions()
+      : EnableTiming(false), MaxRiskLevel(RL_Reasonable),
+        SkipTransformedHeaders(false), Overlay(0) {}
+
   /// \brief Enable the use of performance timers.
   bool EnableTiming;
 
@@ -69,6 +78,93 @@ struct TransformOptions {
 
   /// \brief Maximum allowed level of risk.
   RiskLevel MaxRiskLevel;
+
+  /// \brief Skip changes in headers that an earlier translation unit already
+  /// looked for (see Transform::isFileModifiable()).
+  bool SkipTransformedHeaders;
+
+  /// \brief Files to parse from memory instead of disk, or null.
+  const FileOverlay *Overlay;
+};
+
+/// \brief Numbers of changes made, rejected as too risky and deferred because
+/// of conflicts.
+struct ChangeCounts {
+  ChangeCounts() : Accepted(0), Rejected(0), Deferred(0) {}
+
+  ChangeCounts &operator+=(const ChangeCounts &RHS) {
+    Accepted += RHS.Accepted;
+    Rejected += RHS.Rejected;
+    Deferred += RHS.Deferred;
+    return *this;
+  }
+
+  unsigned Accepted;
+  unsigned Rejected;
+  unsigned Deferred;
+};
+
+/// \brief Performance data of a transform for one translation unit, recorded
+/// when TransformOptions::EnableTiming is set.
+struct SourceProfile {
+  SourceProfile() : Start(0), Callbacks(0), PeakRSS(0) {}
+
+  /// Wall-clock time the translation unit began at, in seconds.
+  double Start;
+
+  /// The whole translation unit, as in the Transform::TimingVec.
+  llvm::TimeRecord Total;
+
+  /// Preprocessing, parsing and semantic analysis, up to the start of
+  /// matching.
+  llvm::TimeRecord Parse;
+
+  /// Traversal of the AST by the matchers, callbacks included.
+  llvm::TimeRecord Matching;
+
+  /// Wall time spent in the callbacks of the matchers, in seconds.
+  double Callbacks;
+
+  /// Peak resident set size of the process at the end of the translation
+  /// unit, in KiB, or 0 if unknown.
+  uint64_t PeakRSS;
+};
+
+/// \brief Runs of the callback of one matcher, recorded when
+/// TransformOptions::EnableTiming is set.
+struct CallbackProfile {
+  CallbackProfile() : Count(0), WallTime(0) {}
+
+  unsigned Count;
+
+  /// In seconds.
+  double WallTime;
+};
+
+/// \brief Set of headers a transform has made changes in.
+///
+/// A header is identified by its path, a hash of its contents and the ranges
+/// the preprocessor skipped in it, so that a header seen with other contents
+/// or other conditional blocks is not considered transformed. The set is shared
+/// by a transform and its copies (see Transforms::createCopies()) and can be
+/// used from several threads.
+class TransformedHeaders {
+public:
+  /// \brief Add \p Key to the set.
+  ///
+  /// \returns \li true if \p Key was not in the set
+  ///          \li false otherwise
+  bool claim(llvm::StringRef Key);
+
+  /// \brief Whether \p Key is in the set.
+  bool contains(llvm::StringRef Key);
+
+  /// \brief Empty the set.
+  void clear();
+
+private:
+  llvm::sys::Mutex Lock;
+  llvm::StringSet<> Keys;
 };
 
 /// \brief Abstract base class for all C++11 migration transforms.
@@ -77,9 +173,15 @@ struct TransformOptions {
 /// FrontendActionFactory to pass to ClangTool::run(). Subclasses are also
 /// responsible for calling setOverrides() before calling ClangTool::run().
 ///
+/// Subclasses whose work is done by AST matchers should also implement
+/// registerMatchers() so that they can share a single parse of each
+/// translation unit with other transforms (see CombinedTransforms).
+///
 /// If timing is enabled (see TransformOptions), per-source performance timing
 /// is recorded and stored in a TimingVec for later access with timing_begin()
-/// and timing_end().
+/// and timing_end(). A SourceProfile splitting the time of each source into
+/// phases is recorded as well, along with the runs of the callbacks passed
+/// through profileCallback().
 class Transform {
 public:
   /// \brief Constructor
@@ -101,6 +203,20 @@ public:
   virtual int apply(const clang::tooling::CompilationDatabase &Database,
                     const std::vector<std::string> &SourcePaths) = 0;
 
+  /// \brief Add the matchers and callbacks of the transform to \p Finder.
+  ///
+  /// The callbacks are owned by the transform and stay valid until the next
+  /// call to registerMatchers(). They count changes directly in the counters
+  /// of the transform, so the counts are right whichever tool runs \p Finder
+  /// as long as handleBeginSource() and handleEndSource() are called around
+  /// each translation unit.
+  ///
+  /// \returns \li true if the matchers were registered
+  ///          \li false if the transform can only be run through apply()
+  virtual bool registerMatchers(clang::ast_matchers::MatchFinder &Finder) {
+    return false;
+  }
+
   /// \brief Query if changes were made during the last call to apply().
   bool getChangesMade() const { return AcceptedChanges > 0; }
 
@@ -122,21 +238,44 @@ public:
   /// \brief Query transform name.
   llvm::StringRef getName() const { return Name; }
 
+  /// \brief Describe the transform-specific options affecting the changes the
+  /// transform makes.
+  ///
+  /// Used to tell results obtained with different options apart (see
+  /// ReplacementCache).
+  virtual std::string describeOptions() const { return std::string(); }
+
   /// \brief Reset internal state of the transform.
   ///
   /// Useful if calling apply() several times with one instantiation of a
-  /// transform.
+  /// transform. Replacements collected so far are discarded.
   void Reset() {
     AcceptedChanges = 0;
     RejectedChanges = 0;
     DeferredChanges = 0;
+    Replacements.clear();
+    SourceCounts.clear();
   }
 
   /// \brief Tests if the file containing \a Loc is allowed to be modified by
-  /// the Modernizer.
+  /// the Modernizer and still needs to be looked at.
+  ///
+  /// Callbacks call this function with the location of the code they would
+  /// change. When TransformOptions::SkipTransformedHeaders is set, a header
+  /// is looked at until a translation unit made changes in it; later
+  /// translation units are told not to modify it since their changes would be
+  /// duplicates.
   bool isFileModifiable(const clang::SourceManager &SM,
                         const clang::SourceLocation &Loc) const;
 
+  /// \brief Tests if the file containing \a Loc is allowed to be modified by
+  /// the Modernizer, whether or not it was already looked at.
+  ///
+  /// For the other locations of a change spanning several files, once its
+  /// main location passed isFileModifiable().
+  bool canModifyFile(const clang::SourceManager &SM,
+                     const clang::SourceLocation &Loc) const;
+
   /// \brief Whether a transformation with a risk level of \p RiskLevel is
   /// acceptable or not.
   bool isAcceptableRiskLevel(RiskLevel RiskLevel) const {
@@ -159,6 +298,13 @@ public:
   /// immediately after the corresponding handleBeginSource() call.
   virtual void handleEndSource();
 
+  /// \brief Called once the translation unit is parsed, before the matchers
+  /// run over it.
+  void handleBeginMatching();
+
+  /// \brief Called once the matchers ran over the translation unit.
+  void handleEndMatching();
+
   /// \brief Performance timing data is stored as a vector of pairs. Pairs are
   /// formed of:
   /// \li Name of source file.
@@ -170,6 +316,28 @@ public:
   /// \brief Return an iterator to the start of collected timing data.
   TimingVec::const_iterator timing_end() const { return Timings.end(); }
 
+  /// \brief Detailed performance data, as pairs of source file name and
+  /// SourceProfile.
+  typedef std::vector<std::pair<std::string, SourceProfile> > ProfileVec;
+
+  /// \brief Return an iterator to the start of collected profiles.
+  ProfileVec::const_iterator profile_begin() const { return Profiles.begin(); }
+  /// \brief Return an iterator to the end of collected profiles.
+  ProfileVec::const_iterator profile_end() const { return Profiles.end(); }
+
+  /// \brief Accessor to the runs of each profiled callback, keyed by the
+  /// label given to profileCallback().
+  const llvm::StringMap<CallbackProfile> &getCallbackProfiles() const {
+    return CallbackProfiles;
+  }
+
+  /// \brief Discard the timings and profiles collected so far.
+  void clearPerfData() {
+    Timings.clear();
+    Profiles.clear();
+    CallbackProfiles.clear();
+  }
+
   /// \brief Add a Replacement to the list for the current translation unit.
   ///
   /// \returns \li true on success
@@ -181,6 +349,46 @@ public:
     return Replacements;
   }
 
+  /// \brief Accessor to the change counts of each transformed translation
+  /// unit, keyed like getAllReplacements().
+  const llvm::StringMap<ChangeCounts> &getSourceChangeCounts() const {
+    return SourceCounts;
+  }
+
+  /// \brief Forget which headers were looked at, e.g. because changes made
+  /// there were dropped.
+  void forgetTransformedHeaders() { Headers->clear(); }
+
+  /// \brief Whether headers changed by an earlier translation unit are
+  /// skipped, provided TransformOptions::SkipTransformedHeaders is set.
+  ///
+  /// Disabled while the transform also runs on translation units whose
+  /// changes are dropped, since these would mark headers as changed.
+  void enableHeaderSkipping(bool Enable) { HeaderSkipping = Enable; }
+
+  /// \brief Share the set of headers looked at with \p Original, of which
+  /// this transform is a copy.
+  void shareTransformedHeaders(Transform &Original) {
+    Headers = Original.Headers;
+  }
+
+  /// \brief Record the results of a translation unit that was not run, e.g.
+  /// because they were cached by an earlier run.
+  ///
+  /// \param Source Main source file of the translation unit.
+  /// \param Counts Changes counted for the translation unit.
+  /// \param Replacements Replacements made for the translation unit.
+  void addSourceResults(
+      llvm::StringRef Source, const ChangeCounts &Counts,
+      const std::vector<clang::tooling::Replacement> &Replacements);
+
+  /// \brief Move the change counts, replacements, timings and profiles
+  /// collected by \p Other, a copy of this transform applied to other sources,
+  /// into this transform.
+  ///
+  /// \post \p Other is reset and has no timing data.
+  void takeResults(Transform &Other);
+
 protected:
 
   void setAcceptedChanges(unsigned Changes) {
@@ -193,6 +401,12 @@ protected:
     DeferredChanges = Changes;
   }
 
+  /// \brief Counters for the callbacks created by registerMatchers() to
+  /// update directly.
+  unsigned &getAcceptedChangesCounter() { return AcceptedChanges; }
+  unsigned &getRejectedChangesCounter() { return RejectedChanges; }
+  unsigned &getDeferredChangesCounter() { return DeferredChanges; }
+
   /// \brief Allows subclasses to manually add performance timer data.
   ///
   /// \p Label should probably include the source file name somehow as the
@@ -200,6 +414,20 @@ protected:
   /// data for all sources processed by this transform.
   void addTiming(llvm::StringRef Label, llvm::TimeRecord Duration);
 
+  /// \brief Wrap \p Callback so that its runs are counted and timed under
+  /// \p Label when timing is enabled.
+  ///
+  /// To be called by registerMatchers() for each matcher added to the
+  /// MatchFinder. \p Label names the matcher in the performance data and
+  /// should be unique within the transform.
+  ///
+  /// \returns \li \p Callback if timing is disabled
+  ///          \li a callback owned by the transform forwarding to \p Callback
+  ///              otherwise
+  clang::ast_matchers::MatchFinder::MatchCallback *
+  profileCallback(clang::ast_matchers::MatchFinder::MatchCallback *Callback,
+                  llvm::StringRef Label);
+
   /// \brief Provide access for subclasses to the TransformOptions they were
   /// created with.
   const TransformOptions &Options() { return GlobalOptions; }
@@ -213,11 +441,46 @@ protected:
       createActionFactory(clang::ast_matchers::MatchFinder &Finder);
 
 private:
+  friend class ProfiledCallback;
+
+  /// \brief Record a run of the callback profiled under \p Label that lasted
+  /// \p WallTime seconds.
+  void addCallbackTime(llvm::StringRef Label, double WallTime);
+
+  /// \brief Whether the file \p ID, \p Entry is in the include list and not
+  /// in the exclude list, cached per file during a translation unit.
+  bool isFileIncluded(clang::FileID ID, const clang::FileEntry *Entry) const;
+
+  /// \brief Whether the header \p ID, \p Entry was changed by an earlier
+  /// translation unit. Otherwise handleEndSource() marks it as changed if this
+  /// one changed it.
+  bool isHeaderTransformed(const clang::SourceManager &SM, clang::FileID ID,
+                           const clang::FileEntry *Entry) const;
+
   const std::string Name;
   const TransformOptions &GlobalOptions;
   TUReplacementsMap Replacements;
   std::string CurrentSource;
+  ChangeCounts CountsAtBegin;
+  llvm::StringMap<ChangeCounts> SourceCounts;
+  TransformedHeaders OwnHeaders;
+  TransformedHeaders *Headers;
+  bool HeaderSkipping;
+  // Filled by the const isFileModifiable().
+  mutable llvm::DenseMap<clang::FileID, bool> FileIncluded;
+  mutable llvm::DenseMap<clang::FileID, bool> HeaderTransformed;
+  // Keys of the headers of the current translation unit that no translation
+  // unit changed yet, by file name.
+  mutable llvm::StringMap<std::vector<std::string> > UnchangedHeaders;
+  // Offsets of the ranges skipped by the preprocessor in each file of the
+  // current translation unit.
+  llvm::DenseMap<clang::FileID, std::vector<unsigned> > SkippedRanges;
+
   TimingVec Timings;
+  ProfileVec Profiles;
+  SourceProfile CurrentProfile;
+  llvm::StringMap<CallbackProfile> CallbackProfiles;
+  llvm::StringMap<ProfiledCallback *> ProfiledCallbacks;
   unsigned AcceptedChanges;
   unsigned RejectedChanges;
   unsigned DeferredChanges;
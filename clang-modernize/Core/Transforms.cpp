@@ -14,6 +14,7 @@
 
 #include "Core/Transforms.h"
 #include "Core/Transform.h"
+#include <algorithm>
 
 namespace cl = llvm::cl;
 
@@ -25,6 +26,12 @@ Transforms::~Transforms() {
        I != E; ++I)
     delete *I;
 
+  for (std::vector<TransformVec>::iterator I = Copies.begin(),
+                                           E = Copies.end();
+       I != E; ++I)
+    for (TransformVec::iterator CI = I->begin(), CE = I->end(); CI != CE; ++CI)
+      delete *CI;
+
   for (OptionMap::iterator I = Options.begin(), E = Options.end(); I != E; ++I)
     delete I->getValue();
 }
@@ -62,10 +69,41 @@ Transforms::createSelectedTransforms(const TransformOptions &GlobalOptions,
       continue;
 
     llvm::OwningPtr<TransformFactory> Factory(I->instantiate());
-    if (Factory->supportsCompilers(RequiredVersions))
+    if (Factory->supportsCompilers(RequiredVersions)) {
       ChosenTransforms.push_back(Factory->createTransform(GlobalOptions));
-    else if (ExplicitlyEnabled)
+      ChosenNames.push_back(I->getName());
+    } else if (ExplicitlyEnabled)
       llvm::errs() << "note: " << '-' << I->getName()
                    << ": transform not available for specified compilers\n";
   }
 }
+
+void Transforms::createCopies(const TransformOptions &Options,
+                              unsigned Count) {
+  Copies.resize(ChosenTransforms.size());
+  for (unsigned N = 0, E = ChosenNames.size(); N != E; ++N) {
+    for (TransformFactoryRegistry::iterator
+             I = TransformFactoryRegistry::begin(),
+             RE = TransformFactoryRegistry::end();
+         I != RE; ++I) {
+      if (ChosenNames[N] != I->getName())
+        continue;
+      llvm::OwningPtr<TransformFactory> Factory(I->instantiate());
+      for (unsigned C = 0; C != Count; ++C) {
+        Transform *Copy = Factory->createTransform(Options);
+        Copy->shareTransformedHeaders(*ChosenTransforms[N]);
+        Copies[N].push_back(Copy);
+      }
+      break;
+    }
+  }
+}
+
+const Transforms::TransformVec &
+Transforms::getCopies(const Transform *T) const {
+  static const TransformVec NoCopies;
+  TransformVec::const_iterator I =
+      std::find(ChosenTransforms.begin(), ChosenTransforms.end(), T);
+  unsigned N = I - ChosenTransforms.begin();
+  return N < Copies.size() ? Copies[N] : NoCopies;
+}
@@ -20,6 +20,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/ADT/StringRef.h"
 
+#include <string>
 #include <vector>
 
 // Forward declarations
@@ -64,6 +65,15 @@ public:
   void createSelectedTransforms(const TransformOptions &Options,
                                 const CompilerVersions &RequiredVersions);
 
+  /// \brief Instantiate \p Count more copies of each selected transform, e.g.
+  /// one for each worker applying a transform in parallel.
+  ///
+  /// Call *after* createSelectedTransforms().
+  void createCopies(const TransformOptions &Options, unsigned Count);
+
+  /// \brief Return the copies of \p T made by createCopies().
+  const TransformVec &getCopies(const Transform *T) const;
+
   /// \brief Return an iterator to the start of a container of instantiated
   /// transforms.
   const_iterator begin() const { return ChosenTransforms.begin(); }
@@ -79,6 +89,10 @@ private:
 
 private:
   TransformVec ChosenTransforms;
+  /// \brief Registry names of the ChosenTransforms.
+  std::vector<std::string> ChosenNames;
+  /// \brief Copies of each of the ChosenTransforms.
+  std::vector<TransformVec> Copies;
   OptionMap Options;
 };
 
@@ -250,6 +250,17 @@ static bool exprReferencesVariable(const ValueDecl *Target, const Expr *E) {
   return Decl && areSameVariable(Target, Decl->getDecl());
 }
 
+/// \brief Returns the outermost function containing the declaration of \p V,
+/// or the translation unit if there is none.
+static const Decl *getOutermostFunction(ASTContext *Context,
+                                        const VarDecl *V) {
+  const Decl *Function = Context->getTranslationUnitDecl();
+  for (const DeclContext *DC = V->getDeclContext(); DC; DC = DC->getParent())
+    if (DC->isFunctionOrMethod())
+      Function = cast<Decl>(DC);
+  return Function;
+}
+
 /// \brief Returns true when two Exprs are equivalent.
 static bool areSameExpr(ASTContext *Context, const Expr *First,
                         const Expr *Second) {
@@ -927,6 +938,7 @@ static const Expr *findContainer(ASTContext *Context, const Expr *BeginExpr,
 }
 
 StringRef LoopFixer::checkDeferralsAndRejections(ASTContext *Context,
+                                                 const VarDecl *LoopVar,
                                                  const Expr *ContainerExpr,
                                                  Confidence ConfidenceLevel,
                                                  const ForStmt *TheLoop) {
@@ -939,7 +951,12 @@ StringRef LoopFixer::checkDeferralsAndRejections(ASTContext *Context,
     return "";
   }
 
-  TUInfo.getParentFinder().gatherAncestors(Context->getTranslationUnitDecl());
+  // Lambdas, blocks and local classes are traversed with the function they
+  // are in, so the outermost function holds all the ancestors of the loop.
+  // Loops of the same function are matched one after the other and share the
+  // maps.
+  TUInfo.getParentFinder().gatherAncestors(
+      getOutermostFunction(Context, LoopVar));
   // Ensure that we do not try to move an expression dependent on a local
   // variable declared inside the loop outside of it!
   DependencyFinderASTVisitor DependencyFinder(
@@ -1011,7 +1028,7 @@ void LoopFixer::findAndVerifyUsages(ASTContext *Context,
   }
 
   std::string ContainerString =
-      checkDeferralsAndRejections(Context, ContainerExpr,
+      checkDeferralsAndRejections(Context, LoopVar, ContainerExpr,
                                   ConfidenceLevel, TheLoop);
   if (ContainerString.empty())
     return;
@@ -107,6 +107,7 @@ private:
   /// text which refers to the container iterated over if the change should
   /// proceed.
   llvm::StringRef checkDeferralsAndRejections(clang::ASTContext *Context,
+                                              const clang::VarDecl *LoopVar,
                                               const clang::Expr *ContainerExpr,
                                               Confidence ConfidenceLevel,
                                               const clang::ForStmt *TheLoop);
@@ -24,42 +24,51 @@ using clang::ast_matchers::MatchFinder;
 using namespace clang::tooling;
 using namespace clang;
 
+LoopConvertTransform::~LoopConvertTransform() {}
+
 int LoopConvertTransform::apply(const CompilationDatabase &Database,
                                 const std::vector<std::string> &SourcePaths) {
   ClangTool LoopTool(Database, SourcePaths);
 
-  unsigned AcceptedChanges = 0;
-  unsigned DeferredChanges = 0;
-  unsigned RejectedChanges = 0;
-
-  TUInfo.reset(new TUTrackingInfo);
+  Reset();
 
   MatchFinder Finder;
-  LoopFixer ArrayLoopFixer(*TUInfo, &AcceptedChanges, &DeferredChanges,
-                           &RejectedChanges, Options().MaxRiskLevel, LFK_Array,
-                           /*Owner=*/ *this);
-  Finder.addMatcher(makeArrayLoopMatcher(), &ArrayLoopFixer);
-  LoopFixer IteratorLoopFixer(*TUInfo, &AcceptedChanges, &DeferredChanges,
-                              &RejectedChanges, Options().MaxRiskLevel,
-                              LFK_Iterator, /*Owner=*/ *this);
-  Finder.addMatcher(makeIteratorLoopMatcher(), &IteratorLoopFixer);
-  LoopFixer PseudoarrrayLoopFixer(*TUInfo, &AcceptedChanges, &DeferredChanges,
-                                  &RejectedChanges, Options().MaxRiskLevel,
-                                  LFK_PseudoArray, /*Owner=*/ *this);
-  Finder.addMatcher(makePseudoArrayLoopMatcher(), &PseudoarrrayLoopFixer);
+  registerMatchers(Finder);
 
   if (int result = LoopTool.run(createActionFactory(Finder))) {
     llvm::errs() << "Error encountered during translation.\n";
     return result;
   }
 
-  setAcceptedChanges(AcceptedChanges);
-  setRejectedChanges(RejectedChanges);
-  setDeferredChanges(DeferredChanges);
-
   return 0;
 }
 
+bool LoopConvertTransform::registerMatchers(MatchFinder &Finder) {
+  TUInfo.reset(new TUTrackingInfo);
+
+  ArrayLoopFixer.reset(new LoopFixer(
+      *TUInfo, &getAcceptedChangesCounter(), &getDeferredChangesCounter(),
+      &getRejectedChangesCounter(), Options().MaxRiskLevel, LFK_Array,
+      /*Owner=*/ *this));
+  Finder.addMatcher(makeArrayLoopMatcher(),
+                    profileCallback(ArrayLoopFixer.get(), "ArrayLoop"));
+  IteratorLoopFixer.reset(new LoopFixer(
+      *TUInfo, &getAcceptedChangesCounter(), &getDeferredChangesCounter(),
+      &getRejectedChangesCounter(), Options().MaxRiskLevel, LFK_Iterator,
+      /*Owner=*/ *this));
+  Finder.addMatcher(makeIteratorLoopMatcher(),
+                    profileCallback(IteratorLoopFixer.get(), "IteratorLoop"));
+  PseudoarrayLoopFixer.reset(new LoopFixer(
+      *TUInfo, &getAcceptedChangesCounter(), &getDeferredChangesCounter(),
+      &getRejectedChangesCounter(), Options().MaxRiskLevel, LFK_PseudoArray,
+      /*Owner=*/ *this));
+  Finder.addMatcher(
+      makePseudoArrayLoopMatcher(),
+      profileCallback(PseudoarrayLoopFixer.get(), "PseudoArrayLoop"));
+
+  return true;
+}
+
 bool
 LoopConvertTransform::handleBeginSource(clang::CompilerInstance &CI,
                                         llvm::StringRef Filename) {
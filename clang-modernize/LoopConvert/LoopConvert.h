@@ -22,6 +22,7 @@
 
 // Forward decl for private implementation.
 struct TUTrackingInfo;
+class LoopFixer;
 
 /// \brief Subclass of Transform that transforms for-loops into range-based
 /// for-loops where possible.
@@ -30,14 +31,24 @@ public:
   LoopConvertTransform(const TransformOptions &Options)
       : Transform("LoopConvert", Options) {}
 
+  virtual ~LoopConvertTransform();
+
   /// \see Transform::run().
   virtual int apply(const clang::tooling::CompilationDatabase &Database,
                     const std::vector<std::string> &SourcePaths) LLVM_OVERRIDE;
 
+  /// \see Transform::registerMatchers().
+  virtual bool registerMatchers(clang::ast_matchers::MatchFinder &Finder)
+      LLVM_OVERRIDE;
+
   virtual bool handleBeginSource(clang::CompilerInstance &CI,
                                  llvm::StringRef Filename) LLVM_OVERRIDE;
+
 private:
   llvm::OwningPtr<TUTrackingInfo> TUInfo;
+  llvm::OwningPtr<LoopFixer> ArrayLoopFixer;
+  llvm::OwningPtr<LoopFixer> IteratorLoopFixer;
+  llvm::OwningPtr<LoopFixer> PseudoarrayLoopFixer;
 };
 
 #endif // CLANG_MODERNIZE_LOOP_CONVERT_H
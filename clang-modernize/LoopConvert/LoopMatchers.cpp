@@ -30,20 +30,24 @@ const char EndVarName[] = "endVar";
 const char DerefByValueResultName[] = "derefByValueResult";
 const char DerefByRefResultName[] = "derefByRefResult";
 
-// shared matchers
-static const TypeMatcher AnyType = anything();
+// Shared matchers. They are built anew for each use, as matchers built by
+// different -j workers must not share (non-atomically) reference-counted nodes.
+static TypeMatcher anyType() { return anything(); }
 
-static const StatementMatcher IntegerComparisonMatcher =
-    expr(ignoringParenImpCasts(declRefExpr(to(
-        varDecl(hasType(isInteger())).bind(ConditionVarName)))));
+static StatementMatcher integerComparisonMatcher() {
+  return expr(ignoringParenImpCasts(declRefExpr(to(
+      varDecl(hasType(isInteger())).bind(ConditionVarName)))));
+}
 
-static const DeclarationMatcher InitToZeroMatcher =
-    varDecl(hasInitializer(ignoringParenImpCasts(
-        integerLiteral(equals(0))))).bind(InitVarName);
+static DeclarationMatcher initToZeroMatcher() {
+  return varDecl(hasInitializer(ignoringParenImpCasts(
+      integerLiteral(equals(0))))).bind(InitVarName);
+}
 
-static const StatementMatcher IncrementVarMatcher =
-    declRefExpr(to(
-        varDecl(hasType(isInteger())).bind(IncrementVarName)));
+static StatementMatcher incrementVarMatcher() {
+  return declRefExpr(to(
+      varDecl(hasType(isInteger())).bind(IncrementVarName)));
+}
 
 // FIXME: How best to document complicated matcher expressions? They're fairly
 // self-documenting...but there may be some unintuitive parts.
@@ -71,15 +75,15 @@ StatementMatcher makeArrayLoopMatcher() {
       expr(hasType(isInteger())).bind(ConditionBoundName);
 
   return forStmt(
-      hasLoopInit(declStmt(hasSingleDecl(InitToZeroMatcher))),
+      hasLoopInit(declStmt(hasSingleDecl(initToZeroMatcher()))),
       hasCondition(anyOf(binaryOperator(hasOperatorName("<"),
-                                        hasLHS(IntegerComparisonMatcher),
+                                        hasLHS(integerComparisonMatcher()),
                                         hasRHS(ArrayBoundMatcher)),
                          binaryOperator(hasOperatorName(">"),
                                         hasLHS(ArrayBoundMatcher),
-                                        hasRHS(IntegerComparisonMatcher)))),
+                                        hasRHS(integerComparisonMatcher())))),
       hasIncrement(unaryOperator(hasOperatorName("++"),
-                                 hasUnaryOperand(IncrementVarMatcher))))
+                                 hasUnaryOperand(incrementVarMatcher()))))
       .bind(LoopName);
 }
 
@@ -214,7 +218,7 @@ StatementMatcher makeIteratorLoopMatcher() {
           hasOperatorName("++"),
           hasUnaryOperand(
             declRefExpr(to(
-              varDecl(hasType(pointsTo(AnyType))).bind(IncrementVarName)
+              varDecl(hasType(pointsTo(anyType()))).bind(IncrementVarName)
             ))
           )
         ),
@@ -329,18 +333,18 @@ StatementMatcher makePseudoArrayLoopMatcher() {
   return forStmt(
       hasLoopInit(anyOf(
           declStmt(declCountIs(2),
-                   containsDeclaration(0, InitToZeroMatcher),
+                   containsDeclaration(0, initToZeroMatcher()),
                    containsDeclaration(1, EndDeclMatcher)),
-          declStmt(hasSingleDecl(InitToZeroMatcher)))),
+          declStmt(hasSingleDecl(initToZeroMatcher())))),
       hasCondition(anyOf(
           binaryOperator(hasOperatorName("<"),
-                         hasLHS(IntegerComparisonMatcher),
+                         hasLHS(integerComparisonMatcher()),
                          hasRHS(IndexBoundMatcher)),
           binaryOperator(hasOperatorName(">"),
                          hasLHS(IndexBoundMatcher),
-                         hasRHS(IntegerComparisonMatcher)))),
+                         hasRHS(integerComparisonMatcher())))),
       hasIncrement(unaryOperator(
           hasOperatorName("++"),
-          hasUnaryOperand(IncrementVarMatcher))))
+          hasUnaryOperand(incrementVarMatcher()))))
       .bind(LoopName);
 }
@@ -17,6 +17,22 @@
 
 using namespace clang;
 
+void StmtAncestorASTVisitor::gatherAncestors(const Decl *Scope) {
+  if (Scope == this->Scope)
+    return;
+
+  StmtAncestors.clear();
+  DeclParents.clear();
+  this->Scope = Scope;
+
+  // Template instantiations are not traversed as part of the translation unit
+  // either, so their statements are never in the maps.
+  const FunctionDecl *Function = dyn_cast<FunctionDecl>(Scope);
+  if (Function && Function->isTemplateInstantiation())
+    return;
+  TraverseDecl(const_cast<Decl *>(Scope));
+}
+
 /// \brief Tracks a stack of parent statements during traversal.
 ///
 /// All this really does is inject push_back() before running
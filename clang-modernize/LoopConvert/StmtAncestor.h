@@ -42,17 +42,18 @@ typedef llvm::SmallVector<const clang::Expr*, 16> ComponentVector;
 class StmtAncestorASTVisitor :
   public clang::RecursiveASTVisitor<StmtAncestorASTVisitor> {
 public:
-  StmtAncestorASTVisitor() {
+  StmtAncestorASTVisitor() : Scope(NULL) {
     StmtStack.push_back(NULL);
   }
 
-  /// \brief Run the analysis on the TranslationUnitDecl.
+  /// \brief Run the analysis on \p Scope: the outermost function containing
+  /// the statements to look up, or the TranslationUnitDecl for statements
+  /// outside of any function.
   ///
-  /// In case we're running this analysis multiple times, don't repeat the work.
-  void gatherAncestors(const clang::TranslationUnitDecl *T) {
-    if (StmtAncestors.empty())
-      TraverseDecl(const_cast<clang::TranslationUnitDecl*>(T));
-  }
+  /// The maps only cover one scope at a time. Running the analysis on another
+  /// scope releases those of the previous one; running it on the same scope
+  /// again does not repeat the work.
+  void gatherAncestors(const clang::Decl *Scope);
 
   /// Accessor for StmtAncestors.
   const StmtParentMap &getStmtToParentStmtMap() {
@@ -67,6 +68,7 @@ public:
   friend class clang::RecursiveASTVisitor<StmtAncestorASTVisitor>;
 
 private:
+  const clang::Decl *Scope;
   StmtParentMap StmtAncestors;
   DeclParentMap DeclParents;
   llvm::SmallVector<const clang::Stmt*, 16> StmtStack;
@@ -21,30 +21,33 @@ using namespace clang;
 using namespace clang::tooling;
 using namespace clang::ast_matchers;
 
+PassByValueTransform::~PassByValueTransform() {}
+
 int PassByValueTransform::apply(const tooling::CompilationDatabase &Database,
                                 const std::vector<std::string> &SourcePaths) {
   ClangTool Tool(Database, SourcePaths);
-  unsigned AcceptedChanges = 0;
-  unsigned RejectedChanges = 0;
+  Reset();
   MatchFinder Finder;
-  ConstructorParamReplacer Replacer(AcceptedChanges, RejectedChanges,
-                                    /*Owner=*/ *this);
-
-  Finder.addMatcher(makePassByValueCtorParamMatcher(), &Replacer);
-
-  // make the replacer available to handleBeginSource()
-  this->Replacer = &Replacer;
+  registerMatchers(Finder);
 
   if (Tool.run(createActionFactory(Finder))) {
     llvm::errs() << "Error encountered during translation.\n";
     return 1;
   }
 
-  setAcceptedChanges(AcceptedChanges);
-  setRejectedChanges(RejectedChanges);
   return 0;
 }
 
+bool PassByValueTransform::registerMatchers(MatchFinder &Finder) {
+  // the replacer is also used by handleBeginSource()
+  Replacer.reset(new ConstructorParamReplacer(getAcceptedChangesCounter(),
+                                              getRejectedChangesCounter(),
+                                              /*Owner=*/ *this));
+  Finder.addMatcher(makePassByValueCtorParamMatcher(),
+                    profileCallback(Replacer.get(), "PassByValueCtorParam"));
+  return true;
+}
+
 bool PassByValueTransform::handleBeginSource(CompilerInstance &CI,
                                              llvm::StringRef Filename) {
   assert(Replacer && "Replacer not set");
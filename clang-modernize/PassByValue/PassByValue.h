@@ -55,19 +55,25 @@ class ConstructorParamReplacer;
 class PassByValueTransform : public Transform {
 public:
   PassByValueTransform(const TransformOptions &Options)
-      : Transform("PassByValue", Options), Replacer(0) {}
+      : Transform("PassByValue", Options) {}
+
+  virtual ~PassByValueTransform();
 
   /// \see Transform::apply().
   virtual int apply(const clang::tooling::CompilationDatabase &Database,
                     const std::vector<std::string> &SourcePaths) LLVM_OVERRIDE;
 
+  /// \see Transform::registerMatchers().
+  virtual bool registerMatchers(clang::ast_matchers::MatchFinder &Finder)
+      LLVM_OVERRIDE;
+
 private:
   /// \brief Setups the \c IncludeDirectives for the replacer.
   virtual bool handleBeginSource(clang::CompilerInstance &CI,
                                  llvm::StringRef Filename) LLVM_OVERRIDE;
 
   llvm::OwningPtr<IncludeDirectives> IncludeManager;
-  ConstructorParamReplacer *Replacer;
+  llvm::OwningPtr<ConstructorParamReplacer> Replacer;
 };
 
 #endif // CLANG_MODERNIZE_PASS_BY_VALUE_H
@@ -134,7 +134,7 @@ void ConstructorParamReplacer::run(const MatchFinder::MatchResult &Result) {
     // If it's impossible to change one of the parameter (e.g: comes from an
     // unmodifiable header) quit the callback now, do not generate any changes.
     if (CharRange.isInvalid() || ValueStr.empty() ||
-        !Owner.isFileModifiable(SM, CharRange.getBegin()))
+        !Owner.canModifyFile(SM, CharRange.getBegin()))
       return;
 
     // 'const Foo &param' -> 'Foo param'
@@ -21,29 +21,39 @@ using namespace clang;
 using namespace clang::tooling;
 using namespace clang::ast_matchers;
 
+ReplaceAutoPtrTransform::~ReplaceAutoPtrTransform() {}
+
 int
 ReplaceAutoPtrTransform::apply(const CompilationDatabase &Database,
                                const std::vector<std::string> &SourcePaths) {
   ClangTool Tool(Database, SourcePaths);
-  unsigned AcceptedChanges = 0;
+  Reset();
   MatchFinder Finder;
-  AutoPtrReplacer Replacer(AcceptedChanges, /*Owner=*/ *this);
-  OwnershipTransferFixer Fixer(AcceptedChanges, /*Owner=*/ *this);
-
-  Finder.addMatcher(makeAutoPtrTypeLocMatcher(), &Replacer);
-  Finder.addMatcher(makeAutoPtrUsingDeclMatcher(), &Replacer);
-  Finder.addMatcher(makeTransferOwnershipExprMatcher(), &Fixer);
+  registerMatchers(Finder);
 
   if (Tool.run(createActionFactory(Finder))) {
     llvm::errs() << "Error encountered during translation.\n";
     return 1;
   }
 
-  setAcceptedChanges(AcceptedChanges);
-
   return 0;
 }
 
+bool ReplaceAutoPtrTransform::registerMatchers(MatchFinder &Finder) {
+  Replacer.reset(
+      new AutoPtrReplacer(getAcceptedChangesCounter(), /*Owner=*/ *this));
+  Fixer.reset(new OwnershipTransferFixer(getAcceptedChangesCounter(),
+                                         /*Owner=*/ *this));
+
+  Finder.addMatcher(makeAutoPtrTypeLocMatcher(),
+                    profileCallback(Replacer.get(), "AutoPtrTypeLoc"));
+  Finder.addMatcher(makeAutoPtrUsingDeclMatcher(),
+                    profileCallback(Replacer.get(), "AutoPtrUsingDecl"));
+  Finder.addMatcher(makeTransferOwnershipExprMatcher(),
+                    profileCallback(Fixer.get(), "TransferOwnershipExpr"));
+  return true;
+}
+
 struct ReplaceAutoPtrFactory : TransformFactory {
   ReplaceAutoPtrFactory() {
     Since.Clang = Version(3, 0);
@@ -19,6 +19,9 @@
 #include "Core/Transform.h"
 #include "llvm/Support/Compiler.h"
 
+class AutoPtrReplacer;
+class OwnershipTransferFixer;
+
 /// \brief Subclass of Transform that transforms the deprecated \c std::auto_ptr
 /// into the C++11 \c std::unique_ptr.
 ///
@@ -46,9 +49,19 @@ public:
   ReplaceAutoPtrTransform(const TransformOptions &Options)
       : Transform("ReplaceAutoPtr", Options) {}
 
+  virtual ~ReplaceAutoPtrTransform();
+
   /// \see Transform::run().
   virtual int apply(const clang::tooling::CompilationDatabase &Database,
                     const std::vector<std::string> &SourcePaths) LLVM_OVERRIDE;
+
+  /// \see Transform::registerMatchers().
+  virtual bool registerMatchers(clang::ast_matchers::MatchFinder &Finder)
+      LLVM_OVERRIDE;
+
+private:
+  llvm::OwningPtr<AutoPtrReplacer> Replacer;
+  llvm::OwningPtr<OwnershipTransferFixer> Fixer;
 };
 
 #endif // CLANG_MODERNIZE_REPLACE_AUTO_PTR_H
@@ -42,21 +42,26 @@ using namespace clang;
 using namespace clang::ast_matchers;
 
 // shared matchers
-static DeclarationMatcher AutoPtrDecl =
-    recordDecl(hasName("auto_ptr"), isFromStdNamespace());
+static DeclarationMatcher autoPtrDecl() {
+  return recordDecl(hasName("auto_ptr"), isFromStdNamespace());
+}
 
-static TypeMatcher AutoPtrType = qualType(hasDeclaration(AutoPtrDecl));
+static TypeMatcher autoPtrType() {
+  return qualType(hasDeclaration(autoPtrDecl()));
+}
 
 // Matcher that finds expressions that are candidates to be wrapped with
 // 'std::move()'.
 //
 // Binds the id \c AutoPtrOwnershipTransferId to the expression.
-static StatementMatcher MovableArgumentMatcher = expr(
-    allOf(isLValue(), hasType(AutoPtrType))).bind(AutoPtrOwnershipTransferId);
+static StatementMatcher movableArgumentMatcher() {
+  return expr(allOf(isLValue(), hasType(autoPtrType())))
+      .bind(AutoPtrOwnershipTransferId);
+}
 
 TypeLocMatcher makeAutoPtrTypeLocMatcher() {
   // skip elaboratedType() as the named type will match soon thereafter.
-  return typeLoc(loc(qualType(AutoPtrType, unless(elaboratedType()))))
+  return typeLoc(loc(qualType(autoPtrType(), unless(elaboratedType()))))
       .bind(AutoPtrTokenId);
 }
 
@@ -69,13 +74,13 @@ StatementMatcher makeTransferOwnershipExprMatcher() {
   StatementMatcher assignOperator =
     operatorCallExpr(allOf(
       hasOverloadedOperatorName("="),
-      callee(methodDecl(ofClass(AutoPtrDecl))),
-      hasArgument(1, MovableArgumentMatcher)));
+      callee(methodDecl(ofClass(autoPtrDecl()))),
+      hasArgument(1, movableArgumentMatcher())));
 
   StatementMatcher copyCtor =
-    constructExpr(allOf(hasType(AutoPtrType),
+    constructExpr(allOf(hasType(autoPtrType()),
                         argumentCountIs(1),
-                        hasArgument(0, MovableArgumentMatcher)));
+                        hasArgument(0, movableArgumentMatcher())));
 
   return anyOf(assignOperator, copyCtor);
 }
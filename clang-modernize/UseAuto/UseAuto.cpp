@@ -20,32 +20,38 @@ using clang::ast_matchers::MatchFinder;
 using namespace clang;
 using namespace clang::tooling;
 
+UseAutoTransform::~UseAutoTransform() {}
+
 int UseAutoTransform::apply(const clang::tooling::CompilationDatabase &Database,
                             const std::vector<std::string> &SourcePaths) {
   ClangTool UseAutoTool(Database, SourcePaths);
 
-  unsigned AcceptedChanges = 0;
+  Reset();
 
   MatchFinder Finder;
-  ReplacementsVec Replaces;
-  IteratorReplacer ReplaceIterators(AcceptedChanges, Options().MaxRiskLevel,
-                                    /*Owner=*/ *this);
-  NewReplacer ReplaceNew(AcceptedChanges, Options().MaxRiskLevel,
-                         /*Owner=*/ *this);
-
-  Finder.addMatcher(makeIteratorDeclMatcher(), &ReplaceIterators);
-  Finder.addMatcher(makeDeclWithNewMatcher(), &ReplaceNew);
+  registerMatchers(Finder);
 
   if (int Result = UseAutoTool.run(createActionFactory(Finder))) {
     llvm::errs() << "Error encountered during translation.\n";
     return Result;
   }
 
-  setAcceptedChanges(AcceptedChanges);
-
   return 0;
 }
 
+bool UseAutoTransform::registerMatchers(MatchFinder &Finder) {
+  ReplaceIterators.reset(new IteratorReplacer(
+      getAcceptedChangesCounter(), Options().MaxRiskLevel, /*Owner=*/ *this));
+  ReplaceNew.reset(new NewReplacer(getAcceptedChangesCounter(),
+                                   Options().MaxRiskLevel, /*Owner=*/ *this));
+
+  Finder.addMatcher(makeIteratorDeclMatcher(),
+                    profileCallback(ReplaceIterators.get(), "IteratorDecl"));
+  Finder.addMatcher(makeDeclWithNewMatcher(),
+                    profileCallback(ReplaceNew.get(), "DeclWithNew"));
+  return true;
+}
+
 struct UseAutoFactory : TransformFactory {
   UseAutoFactory() {
     Since.Clang = Version(2, 9);
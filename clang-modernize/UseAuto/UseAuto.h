@@ -21,6 +21,9 @@
 #include "Core/Transform.h"
 #include "llvm/Support/Compiler.h"
 
+class IteratorReplacer;
+class NewReplacer;
+
 /// \brief Subclass of Transform that transforms type specifiers for variable
 /// declarations into the special C++11 'auto' type specifier for certain cases:
 /// * Iterators of std containers.
@@ -33,9 +36,19 @@ public:
   UseAutoTransform(const TransformOptions &Options)
       : Transform("UseAuto", Options) {}
 
+  virtual ~UseAutoTransform();
+
   /// \see Transform::run().
   virtual int apply(const clang::tooling::CompilationDatabase &Database,
                     const std::vector<std::string> &SourcePaths) LLVM_OVERRIDE;
+
+  /// \see Transform::registerMatchers().
+  virtual bool registerMatchers(clang::ast_matchers::MatchFinder &Finder)
+      LLVM_OVERRIDE;
+
+private:
+  llvm::OwningPtr<IteratorReplacer> ReplaceIterators;
+  llvm::OwningPtr<NewReplacer> ReplaceNew;
 };
 
 #endif // CLANG_MODERNIZE_USE_AUTO_H
@@ -31,32 +31,43 @@ UserNullMacroNames("user-null-macros",
                             "macro names that behave like NULL"),
                    cl::cat(TransformsOptionsCategory), cl::init(""));
 
+UseNullptrTransform::~UseNullptrTransform() {}
+
 int UseNullptrTransform::apply(const CompilationDatabase &Database,
                                const std::vector<std::string> &SourcePaths) {
   ClangTool UseNullptrTool(Database, SourcePaths);
 
-  unsigned AcceptedChanges = 0;
+  Reset();
 
-  llvm::SmallVector<llvm::StringRef, 1> MacroNames;
-  if (!UserNullMacroNames.empty()) {
-    llvm::StringRef S = UserNullMacroNames;
-    S.split(MacroNames, ",");
-  }
   MatchFinder Finder;
-  NullptrFixer Fixer(AcceptedChanges, MacroNames, /*Owner=*/ *this);
-
-  Finder.addMatcher(makeCastSequenceMatcher(), &Fixer);
+  registerMatchers(Finder);
 
   if (int result = UseNullptrTool.run(createActionFactory(Finder))) {
     llvm::errs() << "Error encountered during translation.\n";
     return result;
   }
 
-  setAcceptedChanges(AcceptedChanges);
-
   return 0;
 }
 
+bool UseNullptrTransform::registerMatchers(MatchFinder &Finder) {
+  llvm::SmallVector<llvm::StringRef, 1> MacroNames;
+  if (!UserNullMacroNames.empty()) {
+    llvm::StringRef S = UserNullMacroNames;
+    S.split(MacroNames, ",");
+  }
+  Fixer.reset(new NullptrFixer(getAcceptedChangesCounter(), MacroNames,
+                               /*Owner=*/ *this));
+
+  Finder.addMatcher(makeCastSequenceMatcher(),
+                    profileCallback(Fixer.get(), "CastSequence"));
+  return true;
+}
+
+std::string UseNullptrTransform::describeOptions() const {
+  return "user-null-macros=" + UserNullMacroNames;
+}
+
 struct UseNullptrFactory : TransformFactory {
   UseNullptrFactory() {
     Since.Clang = Version(3, 0);
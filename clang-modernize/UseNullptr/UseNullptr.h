@@ -20,6 +20,8 @@
 #include "Core/Transform.h"
 #include "llvm/Support/Compiler.h" // For LLVM_OVERRIDE
 
+class NullptrFixer;
+
 /// \brief Subclass of Transform that transforms null pointer constants into
 /// C++11's nullptr keyword where possible.
 class UseNullptrTransform : public Transform {
@@ -27,9 +29,21 @@ public:
   UseNullptrTransform(const TransformOptions &Options)
       : Transform("UseNullptr", Options) {}
 
+  virtual ~UseNullptrTransform();
+
   /// \see Transform::run().
   virtual int apply(const clang::tooling::CompilationDatabase &Database,
                     const std::vector<std::string> &SourcePaths) LLVM_OVERRIDE;
+
+  /// \see Transform::registerMatchers().
+  virtual bool registerMatchers(clang::ast_matchers::MatchFinder &Finder)
+      LLVM_OVERRIDE;
+
+  /// \see Transform::describeOptions().
+  virtual std::string describeOptions() const LLVM_OVERRIDE;
+
+private:
+  llvm::OwningPtr<NullptrFixer> Fixer;
 };
 
 #endif // CLANG_MODERNIZE_USE_NULLPTR_H
@@ -15,7 +15,11 @@
 ///
 //===----------------------------------------------------------------------===//
 
+#include "Core/CombinedTransforms.h"
+#include "Core/FileOverlay.h"
+#include "Core/ParallelApply.h"
 #include "Core/PerfSupport.h"
+#include "Core/ReplacementCache.h"
 #include "Core/ReplacementHandling.h"
 #include "Core/Transform.h"
 #include "Core/Transforms.h"
@@ -29,6 +33,7 @@
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Signals.h"
 
@@ -99,9 +104,35 @@ static cl::opt<RiskLevel, /*ExternalStorage=*/true> MaxRiskLevel(
 
 static cl::opt<bool> FinalSyntaxCheck(
     "final-syntax-check",
-    cl::desc("Check for correct syntax after applying transformations"),
+    cl::desc("Check for correct syntax after applying transformations.\n"
+             "Changes are only written to disk if the check passes"),
     cl::init(false), cl::cat(GeneralCategory));
 
+static cl::opt<bool> SingleParse(
+    "single-parse",
+    cl::desc("Run all selected transforms on a single parse of each source.\n"
+             "Changes conflicting with those of an earlier transform are\n"
+             "retried in a follow-up pass on the affected sources only"),
+    cl::init(false), cl::cat(GeneralCategory));
+
+static cl::opt<unsigned> IterateLimit(
+    "iterate",
+    cl::desc("Re-run each transform up to N more times on the sources where\n"
+             "it deferred changes, once the changes of the previous run are\n"
+             "applied, until no changes are deferred (default 0)"),
+    cl::value_desc("N"), cl::init(0), cl::cat(GeneralCategory));
+
+static cl::opt<unsigned>
+Jobs("j", cl::desc("Number of sources to transform in parallel (default 1)"),
+     cl::value_desc("N"), cl::init(1), cl::cat(GeneralCategory));
+
+static cl::opt<std::string> CacheDir(
+    "cache-dir",
+    cl::desc("Directory in which to cache the changes of each transform for\n"
+             "each source. Sources whose files and compile command did not\n"
+             "change since they were cached are not transformed again"),
+    cl::value_desc("directory"), cl::cat(GeneralCategory));
+
 static cl::opt<bool> SummaryMode("summary", cl::desc("Print transform summary"),
                                  cl::init(false), cl::cat(GeneralCategory));
 
@@ -282,6 +313,139 @@ CompilationDatabase *autoDetectCompilations(std::string &ErrorMessage) {
   return 0;
 }
 
+static void printSummary(llvm::StringRef Name, unsigned Accepted,
+                         unsigned Rejected, unsigned Deferred) {
+  llvm::outs() << "Transform: " << Name << " - Accepted: " << Accepted;
+  if (Rejected > 0 || Deferred > 0)
+    llvm::outs() << " - Rejected: " << Rejected << " - Deferred: " << Deferred;
+  llvm::outs() << "\n";
+}
+
+/// \brief Serialize \p Replacements if -serialize-replacements was given,
+/// apply them to the files on disk otherwise.
+///
+/// With -perf, the time it takes is recorded in \p Profile as a phase of
+/// \p TransformName.
+static bool handleReplacements(ReplacementHandling &Handler,
+                               const TUReplacementsMap &Replacements,
+                               llvm::StringRef TransformName,
+                               ProfileData &Profile) {
+  llvm::TimeRecord Time;
+  if (GlobalOptions.EnableTiming)
+    Time -= llvm::TimeRecord::getCurrentTime(true);
+  double Start = -Time.getWallTime();
+
+  bool Result = SerializeOnly ? Handler.serializeReplacements(Replacements)
+                              : Handler.applyReplacements(Replacements);
+
+  if (GlobalOptions.EnableTiming) {
+    Time += llvm::TimeRecord::getCurrentTime(false);
+    ProfileData::PhaseEntry Phase;
+    Phase.Transform = TransformName;
+    Phase.Name = SerializeOnly ? "Serialize" : "Apply";
+    Phase.Start = Start;
+    Phase.Time = Time;
+    Profile.Phases.push_back(Phase);
+  }
+  return Result;
+}
+
+/// \brief Re-run \p T on the sources where it deferred changes and apply its
+/// changes, up to -iterate times or until no changes are deferred.
+///
+/// Only the sources with deferred changes are parsed again, which gives the
+/// same changes as running the whole tool again.
+///
+/// \param Counts Change counts of the run that was just applied, updated with
+/// those of the following passes: accepted changes add up while the rejected
+/// and deferred changes of a source are those of the last pass that ran it.
+/// With -perf, the timings of each pass are added to \p PerfData and
+/// \p Profile.
+///
+/// \returns \li true on success
+///          \li false if a pass failed
+static bool iterateTransform(Transform &T,
+                             const std::vector<Transform *> &Copies,
+                             const CompilationDatabase &Database,
+                             ReplacementHandling &Handler,
+                             SourcePerfData &PerfData, ProfileData &Profile,
+                             ChangeCounts &Counts) {
+  llvm::StringMap<ChangeCounts> SourceCounts;
+  const llvm::StringMap<ChangeCounts> &FirstCounts = T.getSourceChangeCounts();
+  for (llvm::StringMap<ChangeCounts>::const_iterator I = FirstCounts.begin(),
+                                                     E = FirstCounts.end();
+       I != E; ++I)
+    SourceCounts[I->getKey()] = I->getValue();
+
+  for (unsigned Pass = 0; Pass != IterateLimit; ++Pass) {
+    std::vector<std::string> Deferred;
+    for (llvm::StringMap<ChangeCounts>::const_iterator
+             I = SourceCounts.begin(),
+             E = SourceCounts.end();
+         I != E; ++I)
+      if (I->getValue().Deferred > 0)
+        Deferred.push_back(I->getKey());
+    if (Deferred.empty())
+      break;
+
+    // Running the tool again would look at every header again too.
+    T.forgetTransformedHeaders();
+    // The timings of the earlier passes were collected already.
+    T.clearPerfData();
+    int Result = Jobs > 1 ? applyInParallel(T, Copies, Database, Deferred)
+                          : T.apply(Database, Deferred);
+    if (Result != 0)
+      return false;
+
+    if (!handleReplacements(Handler, T.getAllReplacements(), T.getName(),
+                            Profile))
+      return false;
+
+    if (GlobalOptions.EnableTiming) {
+      collectSourcePerfData(T, PerfData);
+      collectProfileData(T, Profile);
+    }
+
+    const llvm::StringMap<ChangeCounts> &PassCounts = T.getSourceChangeCounts();
+    for (llvm::StringMap<ChangeCounts>::const_iterator I = PassCounts.begin(),
+                                                       E = PassCounts.end();
+         I != E; ++I) {
+      ChangeCounts &Source = SourceCounts[I->getKey()];
+      Counts.Accepted += I->getValue().Accepted;
+      Counts.Rejected += I->getValue().Rejected - Source.Rejected;
+      Counts.Deferred += I->getValue().Deferred - Source.Deferred;
+      Source.Rejected = I->getValue().Rejected;
+      Source.Deferred = I->getValue().Deferred;
+    }
+
+    // Without new changes, the same changes would be deferred again.
+    if (T.getAcceptedChanges() == 0)
+      break;
+  }
+  return true;
+}
+
+/// \brief Describe the options affecting the changes of all transforms, to key
+/// the entries of a ReplacementCache.
+static std::string describeConfiguration(const Transforms &TransformManager) {
+  std::string Configuration;
+  llvm::raw_string_ostream OS(Configuration);
+  OS << "risk=" << GlobalOptions.MaxRiskLevel << "\ntransforms=";
+  for (Transforms::const_iterator I = TransformManager.begin(),
+                                  E = TransformManager.end();
+       I != E; ++I)
+    OS << (*I)->getName() << ",";
+
+  const IncludeExcludeInfo &Files = GlobalOptions.ModifiableFiles;
+  OS << "\ninclude=";
+  for (unsigned I = 0, E = Files.getIncludeList().size(); I != E; ++I)
+    OS << Files.getIncludeList()[I] << ",";
+  OS << "\nexclude=";
+  for (unsigned I = 0, E = Files.getExcludeList().size(); I != E; ++I)
+    OS << Files.getExcludeList()[I] << ",";
+  return OS.str();
+}
+
 // Predicate definition for determining whether a file is not included.
 static bool isFileNotIncludedPredicate(llvm::StringRef FilePath) {
   return !GlobalOptions.ModifiableFiles.isFileIncluded(FilePath);
@@ -372,6 +536,18 @@ int main(int argc, const char **argv) {
 
   // Enable timming.
   GlobalOptions.EnableTiming = TimingDirectoryName.getNumOccurrences() > 0;
+  ProfileData Profile;
+  if (GlobalOptions.EnableTiming) {
+    llvm::TimeRecord Now = llvm::TimeRecord::getCurrentTime(true);
+    Profile.Start = Now.getWallTime();
+    Profile.Total -= Now;
+  }
+
+  // Serialized replacements and cache entries must hold all the changes of
+  // their translation unit, including those in headers shared with other
+  // translation units: a later run may reuse them without the translation unit
+  // that transformed the header first.
+  GlobalOptions.SkipTransformedHeaders = !SerializeOnly && CacheDir.empty();
 
   bool CmdSwitchError = false;
   CompilerVersions RequiredVersions =
@@ -381,6 +557,64 @@ int main(int argc, const char **argv) {
 
   TransformManager.createSelectedTransforms(GlobalOptions, RequiredVersions);
 
+  if (Jobs == 0) {
+    llvm::errs() << llvm::sys::path::filename(argv[0])
+                 << ": -j must be at least 1\n";
+    return 1;
+  }
+  if (Jobs > 1 && SingleParse) {
+    llvm::errs() << llvm::sys::path::filename(argv[0])
+                 << ": -j cannot be combined with -single-parse\n";
+    return 1;
+  }
+  if (Jobs > 1 && !haveCommonDirectory(*Compilations, Sources)) {
+    llvm::errs() << "note: -j: the compile commands of the sources run in "
+                    "different directories, transforming one source at a "
+                    "time\n";
+    Jobs = 1;
+  }
+  if (Jobs > 1)
+    TransformManager.createCopies(GlobalOptions, Jobs);
+
+  if (IterateLimit > 0 && (SingleParse || SerializeOnly)) {
+    llvm::errs() << llvm::sys::path::filename(argv[0])
+                 << ": -iterate cannot be combined with -single-parse or "
+                    "-serialize-replacements\n";
+    return 1;
+  }
+
+  // With -final-syntax-check, changes stay in memory until the check passed so
+  // that a failed check leaves all files as they were.
+  FileOverlay Overlay;
+  if (FinalSyntaxCheck && !SerializeOnly) {
+    GlobalOptions.Overlay = &Overlay;
+    ReplacementHandler.setOverlay(&Overlay);
+  }
+
+  if (!CacheDir.empty() && SingleParse) {
+    llvm::errs() << llvm::sys::path::filename(argv[0])
+                 << ": -cache-dir cannot be combined with -single-parse\n";
+    return 1;
+  }
+  OwningPtr<ReplacementCache> Cache;
+  if (!CacheDir.empty()) {
+    // Computing cache keys runs the preprocessor, which changes to the
+    // directory of each compile command.
+    SmallString<128> AbsoluteCacheDir(CacheDir);
+    llvm::error_code EC = llvm::sys::fs::make_absolute(AbsoluteCacheDir);
+    if (!EC)
+      EC = llvm::sys::fs::create_directories(AbsoluteCacheDir.str());
+    if (EC) {
+      llvm::errs() << llvm::sys::path::filename(argv[0])
+                   << ": cannot create cache directory " << CacheDir << ": "
+                   << EC.message() << "\n";
+      return 1;
+    }
+    Cache.reset(new ReplacementCache(AbsoluteCacheDir.str(),
+                                     describeConfiguration(TransformManager),
+                                     GlobalOptions.Overlay));
+  }
+
   if (TransformManager.begin() == TransformManager.end()) {
     if (SupportedCompilers.empty())
       llvm::errs() << llvm::sys::path::filename(argv[0])
@@ -411,55 +645,103 @@ int main(int argc, const char **argv) {
     return 1;
   }
 
-  // If we're asked to apply changes to files on disk, need to locate
-  // clang-apply-replacements.
-  if (!SerializeOnly) {
-    if (!ReplacementHandler.findClangApplyReplacements(argv[0])) {
-      llvm::errs() << "Could not find clang-apply-replacements\n";
-      return 1;
-    }
-
-    if (DoFormat)
-      ReplacementHandler.enableFormatting(FormatStyleOpt, FormatStyleConfig);
-  }
+  // Changes are applied in-process; only serialized replacements need a
+  // destination directory.
+  if (DoFormat)
+    ReplacementHandler.enableFormatting(FormatStyleOpt, FormatStyleConfig);
 
   StringRef TempDestinationDir;
-  if (SerializeLocation.getNumOccurrences() > 0)
-    ReplacementHandler.setDestinationDir(SerializeLocation);
-  else
-    TempDestinationDir = ReplacementHandler.useTempDestinationDir();
+  if (SerializeOnly) {
+    if (SerializeLocation.getNumOccurrences() > 0)
+      ReplacementHandler.setDestinationDir(SerializeLocation);
+    else
+      TempDestinationDir = ReplacementHandler.useTempDestinationDir();
+  }
 
   SourcePerfData PerfData;
 
-  for (Transforms::const_iterator I = TransformManager.begin(),
-                                  E = TransformManager.end();
+  // Transforms to run one after the other, each with its own parse.
+  std::vector<Transform *> Separate(TransformManager.begin(),
+                                    TransformManager.end());
+
+  if (SingleParse) {
+    CombinedTransforms Combined(Separate, Sources, GlobalOptions.Overlay);
+    while (Combined.hasPendingPass()) {
+      if (Combined.runPass(*Compilations) != 0)
+        return 1;
+
+      if (!handleReplacements(ReplacementHandler, Combined.getReplacements(),
+                              "single-parse", Profile))
+        return 1;
+    }
+
+    const std::vector<Transform *> &Unshared = Combined.getUnsharedTransforms();
+    for (unsigned I = 0, E = Separate.size(); I != E; ++I) {
+      Transform *T = Separate[I];
+      if (std::find(Unshared.begin(), Unshared.end(), T) != Unshared.end())
+        continue;
+
+      if (GlobalOptions.EnableTiming) {
+        collectSourcePerfData(*T, PerfData);
+        collectProfileData(*T, Profile);
+      }
+
+      if (SummaryMode) {
+        const ChangeCounts &Counts = Combined.getChangeCounts(I);
+        printSummary(T->getName(), Counts.Accepted, Counts.Rejected,
+                     Counts.Deferred);
+      }
+    }
+    Separate = Unshared;
+  }
+
+  for (std::vector<Transform *>::const_iterator I = Separate.begin(),
+                                                E = Separate.end();
        I != E; ++I) {
     Transform *T = *I;
 
-    if (T->apply(*Compilations, Sources) != 0) {
+    // Only sources without cached results are transformed.
+    std::vector<std::string> Misses;
+    if (Cache)
+      Cache->lookup(*T, *Compilations, Sources, Misses);
+    const std::vector<std::string> &ToApply = Cache ? Misses : Sources;
+
+    int Result = 0;
+    if (!ToApply.empty())
+      Result = Jobs > 1 ? applyInParallel(*T, TransformManager.getCopies(T),
+                                          *Compilations, ToApply)
+                        : T->apply(*Compilations, ToApply);
+    if (Result != 0) {
       // FIXME: Improve ClangTool to not abort if just one file fails.
       return 1;
     }
 
-    if (GlobalOptions.EnableTiming)
-      collectSourcePerfData(*T, PerfData);
+    if (Cache) {
+      Cache->store(*T);
+      Cache->restore(*T);
+    }
 
-    if (SummaryMode) {
-      llvm::outs() << "Transform: " << T->getName()
-                   << " - Accepted: " << T->getAcceptedChanges();
-      if (T->getChangesNotMade()) {
-        llvm::outs() << " - Rejected: " << T->getRejectedChanges()
-                     << " - Deferred: " << T->getDeferredChanges();
-      }
-      llvm::outs() << "\n";
+    if (!handleReplacements(ReplacementHandler, T->getAllReplacements(),
+                            T->getName(), Profile))
+      return 1;
+
+    if (GlobalOptions.EnableTiming) {
+      collectSourcePerfData(*T, PerfData);
+      collectProfileData(*T, Profile);
     }
 
-    if (!ReplacementHandler.serializeReplacements(T->getAllReplacements()))
+    ChangeCounts Counts;
+    Counts.Accepted = T->getAcceptedChanges();
+    Counts.Rejected = T->getRejectedChanges();
+    Counts.Deferred = T->getDeferredChanges();
+    if (IterateLimit > 0 &&
+        !iterateTransform(*T, TransformManager.getCopies(T), *Compilations,
+                          ReplacementHandler, PerfData, Profile, Counts))
       return 1;
 
-    if (!SerializeOnly)
-      if (!ReplacementHandler.applyReplacements())
-        return 1;
+    if (SummaryMode)
+      printSummary(T->getName(), Counts.Accepted, Counts.Rejected,
+                   Counts.Deferred);
   }
 
   // Let the user know which temporary directory the replacements got written
@@ -467,10 +749,18 @@ int main(int argc, const char **argv) {
   if (SerializeOnly && !TempDestinationDir.empty())
     llvm::errs() << "Replacements serialized to: " << TempDestinationDir << "\n";
 
-  if (FinalSyntaxCheck) {
+  if (FinalSyntaxCheck && SerializeOnly) {
     ClangTool SyntaxTool(*Compilations, SourcePaths);
     if (SyntaxTool.run(newFrontendActionFactory<SyntaxOnlyAction>()) != 0)
       return 1;
+  } else if (FinalSyntaxCheck) {
+    // Only sources including a changed file can have new syntax errors.
+    if (checkSyntaxInParallel(*Compilations, Sources, Overlay, Jobs) != 0) {
+      llvm::errs() << "Syntax check failed, no file was changed.\n";
+      return 1;
+    }
+    if (!Overlay.writeFiles())
+      return 1;
   }
 
   // Report execution times.
@@ -479,7 +769,11 @@ int main(int argc, const char **argv) {
     // Use default directory name.
     if (DirectoryName.empty())
       DirectoryName = "./migrate_perf";
-    writePerfDataJSON(DirectoryName, PerfData);
+    Profile.Total += llvm::TimeRecord::getCurrentTime(false);
+    Profile.PeakRSS = getPeakRSS();
+    std::string PerfDataPath = writePerfDataJSON(DirectoryName, PerfData);
+    if (!PerfDataPath.empty())
+      writeProfileData(PerfDataPath, Profile);
   }
 
   return 0;
@@ -3,18 +3,27 @@
 #include <sys/types.h> /* pid_t */
 #include <unistd.h>    /* _exit, fork */
 
+#include <atomic>
+#include <mutex>
 #include <stack>
+#include <thread>
 
 #include "clang/Analysis/CFG.h"
 #include "clang/Analysis/Analyses/Dominators.h"
 #include "clang/Analysis/AnalysisContext.h"
+#include "clang/AST/ASTConsumer.h"
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/AST/ParentMap.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
 
 #include "Loop.h"
 #include "LoopMatchers.h"
 #include "DefUse.h"
 #include "Classifier.h"
+#include "Features.h"
+#include "Fingerprint.h"
+#include "Progress.h"
 #include "Time.h"
 
 using namespace clang;
@@ -22,7 +31,7 @@ using namespace clang::ast_matchers;
 
 using namespace sloopy;
 
-static bool isSpecified(const FunctionDecl *D, std::vector<PresumedLoc> PLs) {
+static bool isSpecified(const FunctionDecl *D, const std::vector<PresumedLoc> &PLs) {
   for (auto PL : PLs) {
     if ((Function.size() == 0 || D->getNameAsString() == Function) &&
         (File.size() == 0 || PL.getFilename() == File) &&
@@ -138,8 +147,8 @@ class ControlDependenceGraph {
     }
 };
 
-static const std::set<const CFGBlock*> getExitingTerminatorConditions(const std::set<const CFGBlock*> Blocks) {
-  std::set<const CFGBlock*> Result;
+static CFGBlockSet getExitingTerminatorConditions(const CFGBlockSet &Blocks) {
+  CFGBlockSet Result(Blocks.getIndex());
   for (auto Block : Blocks) {
     for (CFGBlock::const_succ_iterator I = Block->succ_begin(),
                                        E = Block->succ_end();
@@ -161,16 +170,17 @@ static const std::set<const CFGBlock*> getExitingTerminatorConditions(const std:
   return Result;
 }
 
-static const Stmt *getGotoLCA(const Stmt *S, const FunctionDecl *D) {
+/* PM is built on first use and kept for the other loops of D. */
+static const Stmt *getGotoLCA(const Stmt *S, const FunctionDecl *D, std::unique_ptr<ParentMap> &PM) {
   if (const GotoStmt *GS = dyn_cast<GotoStmt>(S)) {
     // find lca of GOTO and LABEL stmts
     LabelStmt *LS = GS->getLabel()->getStmt();
 
-    ParentMap PM(D->getBody());
+    if (!PM) PM.reset(new ParentMap(D->getBody()));
     std::vector<const Stmt*> GSAncestors;
-    for (const Stmt *P = GS; P; P = PM.getParent(P)) GSAncestors.push_back(P);
+    for (const Stmt *P = GS; P; P = PM->getParent(P)) GSAncestors.push_back(P);
     std::vector<const Stmt*> LSAncestors;
-    for (const Stmt *P = LS; P; P = PM.getParent(P)) LSAncestors.push_back(P);
+    for (const Stmt *P = LS; P; P = PM->getParent(P)) LSAncestors.push_back(P);
 
     std::vector<const Stmt*>::reverse_iterator GSI, LSI, GSE, LSE;
     for (GSI = GSAncestors.rbegin(),
@@ -185,118 +195,216 @@ static const Stmt *getGotoLCA(const Stmt *S, const FunctionDecl *D) {
   return S;
 }
 
-// compute a fixed point of the program slice
-static const NaturalLoop *buildNaturalLoop(
-    const MergedLoopDescriptor &Loop,
-    const NaturalLoop *Unsliced,
-    const ControlDependenceGraph &CDG,
-    const SlicingCriterion SC) {
+static std::string formatFunctionLocation(const FunctionDecl *D, const SourceManager &SM) {
+  PresumedLoc PL = SM.getPresumedLoc(D->getLocation());
+  return (PL.isValid() ? std::string(PL.getFilename()) + " " : "") + "-func " + D->getNameAsString();
+}
+
+static std::string formatLoopLocation(const FunctionDecl *D, const std::vector<PresumedLoc> &LocationID) {
+  std::stringstream sstm;
+  sstm << LocationID.begin()->getFilename()
+       << " -func " << D->getNameAsString()
+       << " -lines ";
+  std::set<unsigned> Lines;
+  for (auto PLBack : LocationID) {
+    Lines.insert(PLBack.getLine());
+  }
+  for (auto Line : Lines) {
+    sstm << Line << ",";
+  }
+  return sstm.str();
+}
+
 #undef DEBUG_TYPE
 #define DEBUG_TYPE "slice"
 
-  DEBUG(llvm::dbgs() << "Starting slice\n");
-
-  const CFGBlock *Header = Loop.Header;
-  std::set<const CFGBlock*> Tails = Loop.Tails;
-  std::set<const CFGBlock*> Body = Loop.Body;
-
-  std::set<const CFGBlock*> VisitedBlocks;
-  std::set<const Stmt*> TrackedStmts;
-  std::set<const VarDecl*> ControlVars(SC.Vars);
-  std::set<const CFGBlock*> TrackedBlocks;
-  size_t OldSize;
-  do {
-    OldSize = TrackedStmts.size();
-
-    // for all statements in the loop's CFG
-    for (auto Block : Body) {
-      for (auto Element : *Block) {
-        auto Opt = Element.getAs<CFGStmt>();
-        assert(Opt);
-        const Stmt *Stmt = Opt->getStmt();
-        if (TrackedStmts.count(Stmt) > 0) continue;
-        DefUseHelper A(Stmt);
-        for (auto Var : ControlVars) {
-          if (A.isDef(Var)) {
+/*
+ * Slices a loop body w.r.t. the variables of a slicing criterion: tracks the
+ * statements defining control variables, the blocks these are control
+ * dependent on, and the variables used by both, up to a fixed point.
+ *
+ * The def-use analysis of each statement, the control dependences of each
+ * block and the variables of each terminator condition are computed once
+ * and shared by all slices of the loop.
+ */
+class LoopSlicer {
+  public:
+    struct Slice {
+      std::set<const VarDecl*> ControlVars;
+      std::set<const Stmt*> TrackedStmts;
+      CFGBlockSet TrackedBlocks;
+      Slice(const CFGBlockIndex &Index) : TrackedBlocks(Index) {}
+    };
+
+  private:
+    const CFGBlockSet &Body;
+    const ControlDependenceGraph &CDG;
+
+    // the statements of the body, analyzed once
+    struct BodyStmt {
+      const CFGBlock *Block;
+      const Stmt *S;
+      DefUseHelper A;
+    };
+    std::vector<BodyStmt> Stmts;
+    // estimated heap allocations of the slices computed so far
+    Allocations SliceAllocations;
+
+    // used variables of a defining substatement
+    std::map<const Stmt*, std::set<const VarDecl*>> Uses;
+    // blocks of the body a block is control dependent on
+    std::map<const CFGBlock*, CFGBlockSet> ControlDependences;
+    // variables of the terminator condition of a tracked block
+    std::map<const CFGBlock*, std::set<const VarDecl*>> ConditionVars;
+
+    const std::set<const VarDecl*> &getUses(const Stmt *SubStmt) {
+      auto I = Uses.find(SubStmt);
+      if (I != Uses.end()) return I->second;
+      DefUseHelper C(SubStmt);
+      return Uses[SubStmt] = C.getUses();
+    }
+
+    const CFGBlockSet &getControlDependences(const CFGBlock *Block) {
+      auto I = ControlDependences.find(Block);
+      if (I != ControlDependences.end()) return I->second;
+      CFGBlockSet Deps(Body.getIndex());
+      for (auto DepBlock : CDG.dependsOn(Block)) {
+        if (Body.count(DepBlock)) Deps.insert(DepBlock);
+      }
+      return ControlDependences.insert(std::make_pair(Block, Deps)).first->second;
+    }
+
+    const std::set<const VarDecl*> &getConditionVars(const CFGBlock *Block) {
+      auto I = ConditionVars.find(Block);
+      if (I != ConditionVars.end()) return I->second;
+      DefUseHelper B(Block->getTerminatorCondition());
+      return ConditionVars[Block] = B.getDefsAndUses();
+    }
+
+  public:
+    LoopSlicer(const CFGBlockSet &Body, const ControlDependenceGraph &CDG) : Body(Body), CDG(CDG) {
+      for (auto Block : Body) {
+        for (auto Element : *Block) {
+          auto Opt = Element.getAs<CFGStmt>();
+          assert(Opt);
+          BodyStmt BS = { Block, Opt->getStmt(), DefUseHelper(Opt->getStmt()) };
+          Stmts.push_back(BS);
+        }
+      }
+    }
+
+    Slice slice(const std::set<const VarDecl*> &Vars) {
+      DEBUG(llvm::dbgs() << "Starting slice\n");
+      Slice S(Body.getIndex());
+      S.ControlVars = Vars;
+      CFGBlockSet VisitedBlocks(Body.getIndex());
+      size_t OldSize;
+      do {
+        OldSize = S.TrackedStmts.size();
+
+        // for all statements in the loop's CFG
+        for (auto &BS : Stmts) {
+          if (S.TrackedStmts.count(BS.S) > 0) continue;
+          for (auto Var : S.ControlVars) {
+            if (not BS.A.isDef(Var)) continue;
             // if one of the control vars is modified in this stmt, track the stmt
-            if (TrackedStmts.insert(Stmt).second) {
+            if (S.TrackedStmts.insert(BS.S).second) {
               DEBUG(
                 llvm::dbgs() << "Tracking stmt: ";
-                Stmt->printPretty(llvm::dbgs(), NULL, PrintingPolicy(LangOptions()));
+                BS.S->printPretty(llvm::dbgs(), NULL, PrintingPolicy(LangOptions()));
                 llvm::dbgs() << "\n";
               );
               // add used variables of defining substmts
-              for (auto SubStmt : A.getDefiningStmts(Var)) {
-                DefUseHelper C(SubStmt);
-                for (auto Var : C.getUses()) {
-                  ControlVars.insert(Var);
-                  DEBUG(llvm::dbgs() << "Tracking var: " << Var->getNameAsString() << "\n");
+              for (auto SubStmt : BS.A.getDefiningStmts(Var)) {
+                for (auto Used : getUses(SubStmt)) {
+                  S.ControlVars.insert(Used);
+                  DEBUG(llvm::dbgs() << "Tracking var: " << Used->getNameAsString() << "\n");
                 }
               }
             }
 
             // see if we have already collected control-dependent nodes,
             // or have yet to do it
-            if (VisitedBlocks.insert(Block).second) {
+            if (VisitedBlocks.insert(BS.Block)) {
               // collect new control variables from each block
               // this block is control dependent on and track that block
-              for (auto DepBlock : CDG.dependsOn(Block)) {
-                if (Body.count(DepBlock) == 0) continue;
-                if (TrackedBlocks.insert(DepBlock).second) {
-                  const class Stmt *Stmt = DepBlock->getTerminatorCondition();
-                  TrackedStmts.insert(Stmt);
-                  DEBUG(
-                    llvm::dbgs() << "Tracking control dependent statement: ";
-                    Stmt->printPretty(llvm::dbgs(), NULL, PrintingPolicy(LangOptions()));
-                    llvm::dbgs() << "\n";
-                  );
-
-                  DefUseHelper B(Stmt);
-                  for (auto Var : B.getDefsAndUses()) {
-                    ControlVars.insert(Var);
-                    DEBUG(llvm::dbgs() << "Tracking control dependent var: " << Var->getNameAsString() << "\n");
-                  }
+              for (auto DepBlock : getControlDependences(BS.Block)) {
+                if (not S.TrackedBlocks.insert(DepBlock)) continue;
+                const Stmt *Condition = DepBlock->getTerminatorCondition();
+                S.TrackedStmts.insert(Condition);
+                DEBUG(
+                  llvm::dbgs() << "Tracking control dependent statement: ";
+                  Condition->printPretty(llvm::dbgs(), NULL, PrintingPolicy(LangOptions()));
+                  llvm::dbgs() << "\n";
+                );
+                for (auto CondVar : getConditionVars(DepBlock)) {
+                  S.ControlVars.insert(CondVar);
+                  DEBUG(llvm::dbgs() << "Tracking control dependent var: " << CondVar->getNameAsString() << "\n");
                 }
               }
             }
           }
         }
-      }
+      } while (S.TrackedStmts.size() > OldSize);
+
+      DEBUG(
+        llvm::dbgs() << "Blocks: ";
+        for (auto Block : S.TrackedBlocks) {
+          llvm::dbgs() << Block->getBlockID();
+          llvm::dbgs() << ", ";
+        }
+        llvm::dbgs() << "\n";
+      );
+
+      SliceAllocations.addNodes<const VarDecl*>(S.ControlVars.size());
+      SliceAllocations.addNodes<const Stmt*>(S.TrackedStmts.size());
+      SliceAllocations += S.TrackedBlocks.allocations();
+      SliceAllocations += VisitedBlocks.allocations();
+      return S;
     }
-  } while (TrackedStmts.size() > OldSize);
 
-  DEBUG(
-    llvm::dbgs() << "Blocks: ";
-    for (auto Block : TrackedBlocks) {
-      llvm::dbgs() << Block->getBlockID();
-      llvm::dbgs() << ", ";
-  }
-    llvm::dbgs() << "\n";
-  );
+    /* Estimated heap allocations of the slicer and the slices it computed. */
+    Allocations allocations() const {
+      Allocations A = SliceAllocations;
+      A.addBlock(Stmts.capacity() * sizeof(BodyStmt));
+      A.addNodes<std::pair<const Stmt*, std::set<const VarDecl*>>>(Uses.size());
+      A.addNodes<std::pair<const CFGBlock*, CFGBlockSet>>(ControlDependences.size());
+      A.addNodes<std::pair<const CFGBlock*, std::set<const VarDecl*>>>(ConditionVars.size());
+      for (auto &Pair : Uses) {
+        A.addNodes<const VarDecl*>(Pair.second.size());
+      }
+      for (auto &Pair : ControlDependences) {
+        A += Pair.second.allocations();
+      }
+      for (auto &Pair : ConditionVars) {
+        A.addNodes<const VarDecl*>(Pair.second.size());
+      }
+      return A;
+    }
+};
 
+static const NaturalLoop *buildNaturalLoop(
+    const MergedLoopDescriptor &Loop,
+    const NaturalLoop *Unsliced,
+    const LoopSlicer::Slice &S) {
   NaturalLoop *Sliced = new NaturalLoop();
-  Sliced->build(Header, Tails, Body, ControlVars, &TrackedStmts, &TrackedBlocks, Unsliced);
+  Sliced->build(Loop.Header, Loop.Tails, Loop.Body, S.ControlVars, &S.TrackedStmts, &S.TrackedBlocks, Unsliced);
   return Sliced;
-
 }
 
 static const NaturalLoop *buildNaturalLoop(
     const MergedLoopDescriptor &Loop,
     const std::set<const VarDecl*> ControlVars) {
-  const CFGBlock *Header = Loop.Header;
-  std::set<const CFGBlock*> Tails = Loop.Tails;
-  std::set<const CFGBlock*> Body = Loop.Body;
-
   NaturalLoop *Unsliced = new NaturalLoop();
-  Unsliced->build(Header, Tails, Body, ControlVars);
+  Unsliced->build(Loop.Header, Loop.Tails, Loop.Body, ControlVars);
     return Unsliced;
 }
 
 static SlicingCriterion slicingCriterionOuterLoop(const MergedLoopDescriptor &Loop) {
   // collect initial control variables
   std::set<const VarDecl*> ControlVars;
-  std::set<const CFGBlock*> ExitingBlocks;
-  std::set<const CFGBlock*> NestedExitingBlocks = getExitingTerminatorConditions(Loop.Body);
+  CFGBlockSet ExitingBlocks(Loop.Body.getIndex());
+  CFGBlockSet NestedExitingBlocks = getExitingTerminatorConditions(Loop.Body);
   DEBUG(llvm::dbgs() << "start SC computation outer loop\n");
   for (auto Block : NestedExitingBlocks) {
     ExitingBlocks.insert(Block);
@@ -318,11 +426,11 @@ static SlicingCriterion slicingCriterionOuterLoop(const MergedLoopDescriptor &Lo
 static SlicingCriterion slicingCriterionAllLoops(const MergedLoopDescriptor &Loop) {
   // collect initial control variables
   std::set<const VarDecl*> ControlVars;
-  std::set<const CFGBlock*> ExitingBlocks;
+  CFGBlockSet ExitingBlocks(Loop.Body.getIndex());
   assert(Loop.NestedLoops.size() > 0);
   DEBUG(llvm::dbgs() << "start SC computation all loops\n");
   for (auto NestedLoop : Loop.NestedLoops) {
-    std::set<const CFGBlock*> NestedExitingBlocks = getExitingTerminatorConditions(NestedLoop->Body);
+    CFGBlockSet NestedExitingBlocks = getExitingTerminatorConditions(NestedLoop->Body);
     for (auto Block : NestedExitingBlocks) {
       ExitingBlocks.insert(Block);
       const Stmt *Stmt = Block->getTerminatorCondition();
@@ -347,14 +455,12 @@ bool isOutermostNestingLoop(const MergedLoopDescriptor *D) {
   return D->NestingLoops.size() == 1;
 }
 
-class FPCallback : public MatchFinder::MatchCallback {
+// calls and function pointer arguments (fpcalls, fpargs of -ml)
+class FPStatistics : public RecursiveASTVisitor<FPStatistics> {
   public:
-    uint64_t calls, fp_calls, args, fp_args, time;
-    FPCallback() : calls(0), fp_calls(0), args(0), fp_args(0), time(0) {}
-    virtual void run(const MatchFinder::MatchResult &Result) {
-      long Begin = now();
-      CallExpr *CE = const_cast<CallExpr*>(Result.Nodes.getNodeAs<CallExpr>(FunctionName));
-
+    uint64_t calls, fp_calls, args, fp_args;
+    FPStatistics() : calls(0), fp_calls(0), args(0), fp_args(0) {}
+    bool VisitCallExpr(CallExpr *CE) {
       calls++;
 
       for (CallExpr::arg_iterator it = CE->arg_begin(); it != CE->arg_end(); ++it) {
@@ -371,27 +477,16 @@ class FPCallback : public MatchFinder::MatchCallback {
           fp_args++;
         }
       }
-      time += (now()-Begin);
+      return true;
   }
 };
 
-class CFGCallback : public MatchFinder::MatchCallback {
+// size of the last CFG and maximal fan-in (cfgblocks, maxindeg of -ml)
+class CFGStatistics {
   public:
-    uint64_t size, max_fan_in, time;
-    CFGCallback() : size(0), max_fan_in(0), time(0) {}
-    /* std::vector<uint32_t> fan_ins; */
-    /* std::vector<uint32_t> fan_outs; */
-    virtual void run(const MatchFinder::MatchResult &Result) {
-      long Begin = now();
-      const FunctionDecl *D = Result.Nodes.getNodeAs<FunctionDecl>(FunctionName);
-      if (!D->hasBody()) return;
-
-      AnalysisDeclContextManager mgr;
-      AnalysisDeclContext *AC = mgr.getContext(D);
-      CFG *CFG                = AC->getCFG();
-
-      /* fan_ins = std::vector<uint32_t>(CFG->size()); */
-
+    uint64_t size, max_fan_in;
+    CFGStatistics() : size(0), max_fan_in(0) {}
+    void add(const CFG *CFG) {
       size = CFG->size();
       for (auto it = CFG->begin(); it != CFG->end(); it++) {
         auto Block = *it;
@@ -399,43 +494,239 @@ class CFGCallback : public MatchFinder::MatchCallback {
           max_fan_in = Block->pred_size();
         }
       }
-      /*   fan_ins.push_back(Block->pred_size()); */
-      /*   /1* fan_outs.push_back(Block->succ_size()); *1/ */
-      /* } */
-      time += (now()-Begin);
   }
 };
 
+// Dumps and views that write to stderr directly (or open windows) would
+// interleave when functions are analyzed concurrently.
+static bool needsSerialAnalysis() {
+  return ViewCFG || DumpCDG || DumpAST || DumpIncrementVars ||
+         ViewSliced || ViewSlicedOuter || ViewUnsliced ||
+         DumpSliced || DumpSlicedOuter || DumpUnsliced;
+}
+
 class FunctionCallback : public MatchFinder::MatchCallback {
   private:
     const ASTContext *Context;
     std::unique_ptr<Classifier> C;
+    // classes of the first loop seen with a given fingerprint, before
+    // per-function classes (FinitePaths, TriviallyNonterminating) are added
+    typedef std::map<LoopFingerprint::hash_type, ClassificationProperty> FingerprintMap;
+    FingerprintMap FingerprintCache;
+    unsigned FingerprintReuses;
+
+    // functions of the current TU deferred for parallel analysis (-j)
+    struct PendingFunction {
+      const FunctionDecl *D;
+      const ASTContext *Context;
+      // owns the CFG built by run()
+      std::unique_ptr<AnalysisDeclContextManager> Mgr;
+      // looked up by run(): workers must not use the SourceManager
+      StmtLocations Locations;
+      std::string Location;
+      ClassificationMap Classifications;
+      std::map<const NaturalLoop*, std::string> LoopLocations;
+      std::string Output;
+      std::vector<LoopFeatures> Features;
+      FunctionMemory Memory;
+      // fingerprints first seen in this function, merged after the join
+      FingerprintMap Fingerprints;
+      unsigned FingerprintReuses;
+    };
+    std::vector<PendingFunction> Pending;
+
+    // -features-csv / -features-bin
+    LoopFeatureWriter *FeatureWriter;
+    // -progress
+    ProgressReporter *Reporter;
+    // -memory-stats
+    MemoryStatsWriter *MemoryWriter;
+
+    void memoryDone(const std::string &Location, const FunctionMemory &Memory) {
+      MemoryWriter->writeFunction(Location, Memory);
+      TotalMemory.add(Memory);
+    }
+
+    static bool sameClasses(ClassificationProperty A, ClassificationProperty B) {
+      A.erase("Time");
+      B.erase("Time");
+      return A == B;
+    }
   public:
-    FunctionCallback() : Context(NULL), time(0) {}
+    FunctionCallback(LoopFeatureWriter *FeatureWriter = NULL, ProgressReporter *Reporter = NULL,
+                     MemoryStatsWriter *MemoryWriter = NULL) :
+      Context(NULL), FingerprintReuses(0), FeatureWriter(FeatureWriter), Reporter(Reporter),
+      MemoryWriter(MemoryWriter), time(0), stats_time(0) {}
     unsigned time;
 
+    // -ml statistics, collected in the same pass over all functions
+    FPStatistics FPStats;
+    CFGStatistics CFGStats;
+    uint64_t stats_time;
+    // -memory-stats, summed over all functions for the -ml row
+    FunctionMemory TotalMemory;
+
     virtual void run(const MatchFinder::MatchResult &Result) {
       long Begin = now();
       const FunctionDecl *D = Result.Nodes.getNodeAs<FunctionDecl>(FunctionName);
       if (!D->hasBody()) return;
+
+      // statistics cover all functions, regardless of -func; the CFG they
+      // build is the one analyzed
+      std::unique_ptr<AnalysisDeclContextManager> Mgr(new AnalysisDeclContextManager());
+      AnalysisDeclContext *AC = Mgr->getContext(D);
+      if (MachineLearning or MachineLearningRaw) {
+        FPStats.TraverseStmt(D->getBody());
+        if (const CFG *CFG = AC->getCFG()) CFGStats.add(CFG);
+        stats_time += (now()-Begin);
+        Begin = now();
+      }
+
       if (Function != "" and D->getNameAsString() != Function) return;
 
+      if (Jobs > 1 and not needsSerialAnalysis()) {
+        // CFG construction allocates from the ASTContext; build it here, on
+        // the thread that owns the context
+        PendingFunction F = { D, Result.Context };
+        F.FingerprintReuses = 0;
+        F.Locations = StmtLocations(*AC->getCFG(), *Result.SourceManager);
+        F.Location = formatFunctionLocation(D, *Result.SourceManager);
+        F.Mgr = std::move(Mgr);
+        Pending.push_back(std::move(F));
+        return;
+      }
+
+      // the ast context doesn't change that often; cache it
+      if (Context != Result.Context) {
+        Context = Result.Context;
+        C.reset(new Classifier(Result.Context));
+      }
+      std::vector<LoopFeatures> Features;
+      FunctionMemory Memory;
+      const std::string Location = formatFunctionLocation(D, *Result.SourceManager);
+      unsigned Loops = analyze(D, AC, StmtLocations(*AC->getCFG(), *Result.SourceManager), Location, *C,
+                               llvm::errs(), Features, FingerprintCache, FingerprintReuses, Memory);
+      for (auto &F : Features) {
+        FeatureWriter->write(F);
+      }
+      if (MemoryWriter) memoryDone(Location, Memory);
+      time += (now()-Begin);
+      if (Reporter) Reporter->functionDone(Location, now()-Begin, Loops);
+    }
+
+    /* Called after each TU, once its functions are analyzed. Parsed is
+       false for TUs loaded from .ast files, which -progress does not count. */
+    void TUDone(const ASTContext &Context, bool Parsed) {
+      const SourceManager &SM = Context.getSourceManager();
+      if (Reporter and Parsed) {
+        if (Context.getDiagnostics().hasErrorOccurred()) {
+          Reporter->TUFailed();
+        } else {
+          Reporter->TUDone();
+        }
+      }
+      if (MemoryWriter) {
+        const FileEntry *Main = SM.getFileEntryForID(SM.getMainFileID());
+        MemoryWriter->writeTU(Main ? Main->getName() : "");
+      }
+    }
+
+    /*
+     * Analyzes the functions collected by run() on a pool of -j threads.
+     * Must be called while the TU's AST is alive (s. SloopyConsumer).
+     * Workers pull functions from a shared index and write classes, loop
+     * locations, output and new fingerprints to the function's own slot;
+     * these are merged in match order, so results don't depend on
+     * scheduling. Workers only read FingerprintCache: with
+     * -reuse-fingerprints, a fingerprint first seen in another function of
+     * the same TU is reused from the next TU on.
+     */
+    void analyzePending() {
+      if (Pending.empty()) return;
+      long Begin = now();
+
+      std::atomic<size_t> Next(0);
+      auto Worker = [&]() {
+        std::unique_ptr<Classifier> WorkerC;
+        const ASTContext *WorkerContext = NULL;
+        for (size_t I = Next++; I < Pending.size(); I = Next++) {
+          PendingFunction &F = Pending[I];
+          // classifiers keep mutable scratch state; one per thread
+          if (WorkerContext != F.Context) {
+            WorkerContext = F.Context;
+            WorkerC.reset(new Classifier(F.Context));
+          }
+          CurrentClassifications = &F.Classifications;
+          CurrentLoopLocations = &F.LoopLocations;
+          llvm::raw_string_ostream OS(F.Output);
+          long FunctionBegin = now();
+          unsigned Loops = analyze(F.D, F.Mgr->getContext(F.D), F.Locations, F.Location, *WorkerC, OS,
+                                   F.Features, F.Fingerprints, F.FingerprintReuses, F.Memory);
+          OS.flush();
+          if (Reporter) Reporter->functionDone(F.Location, now()-FunctionBegin, Loops);
+        }
+      };
+
+      std::vector<std::thread> Threads;
+      unsigned NumThreads = std::min<size_t>(Jobs, Pending.size());
+      for (unsigned I = 1; I < NumThreads; I++) {
+        Threads.push_back(std::thread(Worker));
+      }
+      Worker();
+      for (auto &T : Threads) {
+        T.join();
+      }
+      CurrentClassifications = &Classifications;
+      CurrentLoopLocations = &LoopLocationMap;
+
+      for (auto &F : Pending) {
+        Classifications.insert(F.Classifications.begin(), F.Classifications.end());
+        LoopLocationMap.insert(F.LoopLocations.begin(), F.LoopLocations.end());
+        llvm::errs() << F.Output;
+        for (auto &Features : F.Features) {
+          FeatureWriter->write(Features);
+        }
+        FingerprintCache.insert(F.Fingerprints.begin(), F.Fingerprints.end());
+        FingerprintReuses += F.FingerprintReuses;
+        if (MemoryWriter) memoryDone(F.Location, F.Memory);
+      }
+      Pending.clear();
+      time += (now()-Begin);
+    }
+
+    /*
+     * Returns the number of loops of D. Fingerprints are looked up in
+     * NewFingerprints, then in FingerprintCache; new ones go to
+     * NewFingerprints. With -memory-stats, D's memory use goes to Memory.
+     * Locations and FunctionLocation (s. formatFunctionLocation) are looked
+     * up in advance; analyze doesn't use the SourceManager.
+     */
+    unsigned analyze(const FunctionDecl *D, AnalysisDeclContext *AC, const StmtLocations &Locations,
+                     const std::string &FunctionLocation, const Classifier &C, raw_ostream &OS,
+                     std::vector<LoopFeatures> &Features, FingerprintMap &NewFingerprints, unsigned &Reuses,
+                     FunctionMemory &Memory) {
       DEBUG_WITH_TYPE("progress",
-          llvm::dbgs() << "Processing: " << Result.SourceManager->getPresumedLoc(D->getLocation()).getFilename() << " " << D->getNameAsString() << "\n";
+          llvm::dbgs() << "Processing: " << FunctionLocation << "\n";
           llvm::dbgs().flush();
       );
 
       std::map<const CFGBlock*, std::vector<LoopDescriptor>> Loops;
 
-      AnalysisDeclContextManager mgr;
-      AnalysisDeclContext *AC = mgr.getContext(D);
       CFG *CFG = AC->getCFG();
+      CFGBlockIndex Index(*CFG);
 
       if (ViewCFG) CFG->viewCFG(LangOptions());
 
+      // past -max-cfg-blocks (or -max-loop-blocks for a loop), loops are not
+      // sliced and only get the structural classes
+      bool DegradedCFG = MaxCFGBlocks and CFG->size() > MaxCFGBlocks;
+      std::set<const NaturalLoop*> Degraded;
+
       ControlDependenceGraph CDG;
-      CDG.build(*AC);
-      if (DumpCDG) CDG.dump();
+      if (not DegradedCFG) {
+        CDG.build(*AC);
+        if (DumpCDG) CDG.dump();
+      }
 
       DominatorTree Dom;
       Dom.buildDominatorTree(*AC);
@@ -451,14 +742,15 @@ class FunctionCallback : public MatchFinder::MatchCallback {
           if (Dom.dominates(Header, Tail) and
               Dom.isReachableFromEntry(Tail)) {  // Unreachable nodes are dominated by everything
             // collect loop blocks via DFS on reverse CFG
-            std::set<const CFGBlock*> Body = { Header };
+            CFGBlockSet Body(Index);
+            Body.insert(Header);
             std::stack<const CFGBlock*> worklist;
             worklist.push(Tail);
             while (worklist.size() > 0) {
               const CFGBlock *current = worklist.top();
               worklist.pop();
 
-              if (!Body.insert(current).second) {
+              if (!Body.insert(current)) {
                 continue;
               }
 
@@ -479,17 +771,15 @@ class FunctionCallback : public MatchFinder::MatchCallback {
 
       // Merge loops with the same header.
       std::vector<MergedLoopDescriptor> LoopsAfterMerging;
-      for (auto L : Loops) {
+      for (auto &L : Loops) {
         const CFGBlock *Header = L.first;
-        auto List = L.second;
+        auto &List = L.second;
         bool IsTriviallyNonterminating = true;
         
-        std::set<const CFGBlock*> MergedBody;
-        std::set<const CFGBlock*> MergedTails;
-        for (auto L2 : List) {
-          for (const CFGBlock *Block : L2.Body) {
-            MergedBody.insert(Block);
-          }
+        CFGBlockSet MergedBody(Index);
+        CFGBlockSet MergedTails(Index);
+        for (auto &L2 : List) {
+          MergedBody |= L2.Body;
           MergedTails.insert(L2.Tail);
           IsTriviallyNonterminating = IsTriviallyNonterminating and L2.IsTriviallyNonterminating;
         }
@@ -499,10 +789,8 @@ class FunctionCallback : public MatchFinder::MatchCallback {
       // Determine nested
       for (auto &Loop1 : LoopsAfterMerging) {
         for (auto &Loop2 : LoopsAfterMerging) {
-          if (std::includes(Loop1.Body.begin(), Loop1.Body.end(),
-                            Loop2.Body.begin(), Loop2.Body.end())) {
-            if (std::includes(Loop2.Body.begin(), Loop2.Body.end(),
-                              Loop1.Body.begin(), Loop1.Body.end())) {
+          if (Loop1.Body.includes(Loop2.Body)) {
+            if (Loop2.Body.includes(Loop1.Body)) {
               // subset(1, 2) && subset(2, 1) => 1 = 2
               Loop2.addTriviallyNestedLoop(&Loop2);
             } else {
@@ -515,65 +803,86 @@ class FunctionCallback : public MatchFinder::MatchCallback {
 #undef DEBUG_TYPE
 #define DEBUG_TYPE "buildNaturalLoop"
 
+      // Per-function caches: the location of each loop, its formatted string
+      // (only built when printed) and the parent map for goto loops.
+      std::map<const NaturalLoop*, std::vector<PresumedLoc>> LocationIDs;
+      std::unique_ptr<ParentMap> PM;
+      // -memory-stats: each loop's graphs and slicer, and its z3 peak
+      std::map<const NaturalLoop*, Allocations> LoopAllocations;
+      std::map<const NaturalLoop*, uint64_t> LoopZ3PeakBytes;
+      auto getLocation = [&](const NaturalLoop *Unsliced) -> const std::string & {
+        std::string &Location = (*CurrentLoopLocations)[Unsliced];
+        if (Location.empty()) Location = formatLoopLocation(D, LocationIDs[Unsliced]);
+        return Location;
+      };
+
       std::map<MergedLoopDescriptor, std::vector<const NaturalLoop*>> M;
       for (auto &Loop : LoopsAfterMerging) {
+        if (DegradedCFG or (MaxLoopBlocks and Loop.Body.size() > MaxLoopBlocks)) {
+          const NaturalLoop *Unsliced = buildNaturalLoop(Loop, std::set<const VarDecl*>());
+          Degraded.insert(Unsliced);
+          LocationIDs[Unsliced] = Unsliced->getLoopStmtID(Locations);
+          if (LoopStats or Server or ServerSocket != "") getLocation(Unsliced);
+          if (MemoryWriter) LoopAllocations[Unsliced] = Unsliced->allocations();
+          // stands in for the slices
+          M[Loop].push_back(Unsliced);
+          M[Loop].push_back(Unsliced);
+          M[Loop].push_back(Unsliced);
+          continue;
+        }
+
         auto SC = slicingCriterionAllLoops(Loop);
         DEBUG(llvm::dbgs() << "build unsliced\n");
         const NaturalLoop *Unsliced = buildNaturalLoop(Loop, SC.Vars);
         if (!Unsliced) continue;
         /* Unsliced->view(); */
+        // both slices share the analyses of the body's statements
+        LoopSlicer Slicer(Loop.Body, CDG);
         DEBUG(llvm::dbgs() << "build sliced all\n");
-        const NaturalLoop *SlicedAllLoops = buildNaturalLoop(Loop, Unsliced, CDG, SC);
+        const NaturalLoop *SlicedAllLoops = buildNaturalLoop(Loop, Unsliced, Slicer.slice(SC.Vars));
         /* SlicedAllLoops->view(); */
         DEBUG(llvm::dbgs() << "build sliced outer\n");
-        const NaturalLoop *SlicedOuterLoop = buildNaturalLoop(Loop, Unsliced, CDG, slicingCriterionOuterLoop(Loop));
+        const NaturalLoop *SlicedOuterLoop = buildNaturalLoop(Loop, Unsliced, Slicer.slice(slicingCriterionOuterLoop(Loop).Vars));
+        if (MemoryWriter) {
+          Allocations &A = LoopAllocations[Unsliced];
+          A += Unsliced->allocations();
+          A += SlicedAllLoops->allocations();
+          A += SlicedOuterLoop->allocations();
+          A += Slicer.allocations();
+        }
 
 #undef DEBUG_TYPE
 #define DEBUG_TYPE ""
 
-        auto LocationID = Unsliced->getLoopStmtID(Result.SourceManager);
-        std::stringstream sstm;
-        sstm << LocationID.begin()->getFilename()
-             << " -func " << D->getNameAsString()
-             << " -lines ";
-        std::set<unsigned> Lines;
-        for (auto PLBack : LocationID) {
-          Lines.insert(PLBack.getLine());
-        }
-        for (auto Line : Lines) {
-          sstm << Line << ",";
-        }
-        LoopLocationMap[Unsliced] = sstm.str();
+        LocationIDs[Unsliced] = Unsliced->getLoopStmtID(Locations);
+        // the JSON is written (and -server answers) after the TU is gone;
+        // format it now
+        if (LoopStats or Server or ServerSocket != "") getLocation(Unsliced);
 
         M[Loop].push_back(Unsliced);
         M[Loop].push_back(SlicedAllLoops);
         M[Loop].push_back(SlicedOuterLoop);
       }
 
-      // the ast context doesn't change that often; cache it
-      if (Context != Result.Context) {
-        Context = Result.Context;
-        C.reset(new Classifier(Result.Context));
-      }
-      for (auto Pair : M) {
-        auto MLD = Pair.first;
+      for (auto &Pair : M) {
+        const MergedLoopDescriptor &MLD = Pair.first;
         const NaturalLoop *Unsliced = M[MLD][0];
         const NaturalLoop *SlicedAllLoops = M[MLD][1];
         const NaturalLoop *SlicedOuterLoop = M[MLD][2];
 
-        auto LocationID = Unsliced->getLoopStmtID(Result.SourceManager);
+        const std::vector<PresumedLoc> &LocationID = LocationIDs[Unsliced];
         if (isSpecified(D, LocationID)) {
           if (DumpControlVars) {
             for (auto VD : Unsliced->getControlVars()) {
-              llvm::errs() << "Control variable: " << VD->getNameAsString() << " (" << VD->getType().getAsString() << ")\n";
+              OS << "Control variable: " << VD->getNameAsString() << " (" << VD->getType().getAsString() << ")\n";
             }
           }
           if (DumpStmt) {
-            const Stmt *S = getGotoLCA(Unsliced->getLoopStmt(), D);
-            S->printPretty(llvm::errs(), NULL, PrintingPolicy(LangOptions()));
+            const Stmt *S = getGotoLCA(Unsliced->getLoopStmt(), D, PM);
+            S->printPretty(OS, NULL, PrintingPolicy(LangOptions()));
           }
           if (DumpAST) {
-            const Stmt *S = getGotoLCA(Unsliced->getLoopStmt(), D);
+            const Stmt *S = getGotoLCA(Unsliced->getLoopStmt(), D, PM);
             S->dump();
           }
           if (ViewSliced || ViewSlicedOuter || ViewUnsliced or
@@ -619,11 +928,53 @@ class FunctionCallback : public MatchFinder::MatchCallback {
           ProperlyNestedLoops.push_back(M[**I][1]);
         }
 
-        C->classify(isSpecified(D, LocationID), Unsliced, SlicedAllLoops, SlicedOuterLoop, OutermostNestingLoop, NestingLoops, ProperlyNestedLoops);
+        if (Degraded.count(Unsliced)) {
+          C.classifyDegraded(Unsliced);
+          continue;
+        }
+
+        // Amortized classes depend on the enclosing loops, which are not part
+        // of the fingerprint. Reused loops don't dump their increment vars.
+        const LoopFingerprint Fingerprint(Unsliced, SlicedAllLoops, SlicedOuterLoop);
+        bool Reuse = false, Verify = false;
+        ClassificationProperty CachedClasses;
+        if (ReuseFingerprints) {
+          const ClassificationProperty *Cached = NULL;
+          auto New = NewFingerprints.find(Fingerprint.getHash());
+          auto Old = FingerprintCache.find(Fingerprint.getHash());
+          if (New != NewFingerprints.end()) Cached = &New->second;
+          else if (Old != FingerprintCache.end()) Cached = &Old->second;
+          if (Cached and not EnableAmortized and
+              not (isSpecified(D, LocationID) and DumpIncrementVars)) {
+            Reuse = true;
+            CachedClasses = *Cached;
+            Reuses++;
+            Verify = VerifyFingerprints and Reuses % VerifyFingerprints == 0;
+          }
+        }
+        Z3PeakBytes = 0;
+        if (Reuse and not Verify) {
+          long Begin = now();
+          (*CurrentClassifications)[Unsliced] = CachedClasses;
+          LoopClassifier::classify(Unsliced, "FingerprintReused");
+          LoopClassifier::classify(Unsliced, "Time", (int)(now()-Begin));
+        } else {
+          C.classify(isSpecified(D, LocationID), Unsliced, SlicedAllLoops, SlicedOuterLoop, OutermostNestingLoop, NestingLoops, ProperlyNestedLoops);
+          if (Verify and not sameClasses((*CurrentClassifications)[Unsliced], CachedClasses)) {
+            OS << "warning: fingerprint " << Fingerprint.str()
+               << " reused for differently classified loop "
+               << getLocation(Unsliced) << "\n";
+          }
+          if (ReuseFingerprints and not Reuse) {
+            NewFingerprints.insert({ Fingerprint.getHash(), (*CurrentClassifications)[Unsliced] });
+          }
+        }
+        if (MemoryWriter) LoopZ3PeakBytes[Unsliced] = Z3PeakBytes;
+        LoopClassifier::classify(Unsliced, "Fingerprint", Fingerprint.str());
       }
 
-      for (auto Pair : M) {
-        auto MLD = Pair.first;
+      for (auto &Pair : M) {
+        const MergedLoopDescriptor &MLD = Pair.first;
         auto NestingLoops = MLD.NestingLoops;
 
         LoopClassifier::classify(Pair.second[0], "TriviallyNonterminating", MLD.IsTriviallyNonterminating);
@@ -638,35 +989,107 @@ next_loop:
         ;
       }
 
+      // with -memory-stats, the classes (and so the -loop-stats JSON) carry
+      // each loop's estimated memory use, that of its class record without
+      // these classes
+      if (MemoryWriter) {
+        Memory.Loops = M.size();
+        for (auto &Pair : M) {
+          const NaturalLoop *Unsliced = Pair.second[0];
+          const Allocations &Loop = LoopAllocations[Unsliced];
+          Allocations Classification = classificationAllocations((*CurrentClassifications)[Unsliced]);
+          uint64_t Z3Peak = LoopZ3PeakBytes[Unsliced];
+          LoopClassifier::classify(Unsliced, "LoopAllocations", (unsigned)Loop.Count);
+          LoopClassifier::classify(Unsliced, "LoopBytes", (unsigned)Loop.Bytes);
+          LoopClassifier::classify(Unsliced, "ClassificationAllocations", (unsigned)Classification.Count);
+          LoopClassifier::classify(Unsliced, "ClassificationBytes", (unsigned)Classification.Bytes);
+          LoopClassifier::classify(Unsliced, "Z3PeakKiB", (unsigned)(Z3Peak / 1024));
+          Memory.LoopAllocations += Loop;
+          Memory.ClassificationAllocations += Classification;
+          Memory.Z3PeakBytes = std::max(Memory.Z3PeakBytes, Z3Peak);
+        }
+      }
+
+      if (FeatureWriter) {
+        for (auto &Pair : M) {
+          const NaturalLoop *Unsliced = Pair.second[0];
+          Features.push_back(LoopFeatures(getLocation(Unsliced), Unsliced,
+                Pair.first.NestingLoops.size(), (*CurrentClassifications)[Unsliced]));
+        }
+      }
+
       // InfluencesOuter is only classified when we reach the outer loop,
       // so we have to loop once again to show all classes.
-      for (auto Pair : M) {
-        auto MLD = Pair.first;
+      for (auto &Pair : M) {
+        const MergedLoopDescriptor &MLD = Pair.first;
         const NaturalLoop *Unsliced = M[MLD][0];
-        auto LocationID = Unsliced->getLoopStmtID(Result.SourceManager);
 
-        if (isSpecified(D, LocationID)) {
-          if ((HasClass == std::string() && !LoopStats && !MachineLearning) ||
+        if (isSpecified(D, LocationIDs[Unsliced])) {
+          if ((HasClass == std::string() && !LoopStats && !MachineLearning && !MachineLearningRaw && !Server && ServerSocket == "") ||
               (HasClass != std::string() && LoopClassifier::hasClass(Unsliced, HasClass))) {
-            llvm::errs() << LoopLocationMap[Unsliced] << "\n";
+            OS << getLocation(Unsliced) << "\n";
             if (DumpClasses || DumpClassesAll) {
-              dumpClasses(llvm::errs(), Classifications[Unsliced]);
+              dumpClasses(OS, (*CurrentClassifications)[Unsliced]);
             }
           }
           if (DumpBlocks || DumpControlVars || DumpControlVarsDetail || DumpClasses || DumpClassesAll || DumpAST || DumpStmt || DumpIncrementVars) {
-            llvm::errs() << "----------\n";
+            OS << "----------\n";
           }
         }
       }
 
-      for (auto Pair : M) {
-        auto MLD = Pair.first;
+      for (auto &Pair : M) {
+        const MergedLoopDescriptor &MLD = Pair.first;
         /* const NaturalLoop *Unsliced = M[MLD][0]; */
         const NaturalLoop *SlicedAllLoops = M[MLD][1];
         const NaturalLoop *SlicedOuterLoop = M[MLD][2];
+        if (Degraded.count(SlicedAllLoops)) continue;
         delete SlicedAllLoops;
         delete SlicedOuterLoop;
       }
-      time += (now()-Begin);
+      return M.size();
+    }
+};
+
+// Runs the matchers on a TU, then analyzes the functions FunctionCallback
+// deferred for -j while the AST is still alive.
+class SloopyConsumer : public ASTConsumer {
+  MatchFinder &Finder;
+  FunctionCallback &FC;
+  const bool Parsed;
+  public:
+    SloopyConsumer(MatchFinder &Finder, FunctionCallback &FC, bool Parsed = true) :
+      Finder(Finder), FC(FC), Parsed(Parsed) {}
+    virtual void HandleTranslationUnit(ASTContext &Context) {
+      Finder.matchAST(Context);
+      FC.analyzePending();
+      FC.TUDone(Context, Parsed);
+    }
+};
+
+class SloopyConsumerFactory {
+  MatchFinder &Finder;
+  FunctionCallback &FC;
+  public:
+    SloopyConsumerFactory(MatchFinder &Finder, FunctionCallback &FC) : Finder(Finder), FC(FC) {}
+    ASTConsumer *newASTConsumer() {
+      return new SloopyConsumer(Finder, FC);
     }
 };
+
+/*
+ * Runs the analysis on a serialized AST (clang -emit-ast), skipping parsing.
+ * Declarations are deserialized lazily as the matchers traverse them.
+ */
+static bool analyzeASTFile(const std::string &Filename, MatchFinder &Finder, FunctionCallback &FC) {
+  IntrusiveRefCntPtr<DiagnosticsEngine> Diags =
+    CompilerInstance::createDiagnostics(new DiagnosticOptions());
+  OwningPtr<ASTUnit> AST(ASTUnit::LoadFromASTFile(Filename, Diags, FileSystemOptions()));
+  if (!AST) {
+    llvm::errs() << "error: cannot load AST file " << Filename << "\n";
+    return false;
+  }
+  SloopyConsumer Consumer(Finder, FC, /*Parsed=*/false);
+  Consumer.HandleTranslationUnit(AST->getASTContext());
+  return true;
+}
@@ -40,7 +40,8 @@ class Classifier {
         const std::vector<const NaturalLoop*> ProperlyNestedLoops) const {
       long Begin = now();
 
-      if (MachineLearning) {
+      // the -ml-raw rows of shards must add up to the -ml row
+      if (MachineLearning or MachineLearningRaw) {
         ALC.classify(Unsliced); // ANY + Stmt
         MasterPC.classify(Unsliced, SyntacticTerm);
         MasterPC.classify(Unsliced, AnyExitWeakCfWellformed);
@@ -133,5 +134,14 @@ class Classifier {
 
       LoopClassifier::classify(Unsliced, "Time", (int)(now()-Begin));
     }
+
+    /* The structural classes only, for loops too large to slice. */
+    void classifyDegraded(const NaturalLoop *Unsliced) const {
+      long Begin = now();
+      ALC.classify(Unsliced); // ANY + Stmt
+      SLC.classify(Unsliced);
+      LoopClassifier::classify(Unsliced, "Degraded");
+      LoopClassifier::classify(Unsliced, "Time", (int)(now()-Begin));
+    }
 };
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <mutex>
+
 /* type predicates */
 
 typedef bool (*TypePredicate)(const VarDecl *);
@@ -14,8 +16,12 @@ static bool isPointerType(const VarDecl *VD) {
 
 /* integer constants */
 
+/* Evaluation fills the ASTContext's type and layout caches; -j workers share the context. */
+static std::mutex ConstantEvaluationMutex;
+
 static bool isIntegerConstant(const Expr *Expression, const ASTContext *Context) {
   llvm::APSInt Result;
+  std::lock_guard<std::mutex> Lock(ConstantEvaluationMutex);
   if (Expression->EvaluateAsInt(Result, const_cast<ASTContext&>(*Context))) {
     return true;
   }
@@ -24,6 +30,7 @@ static bool isIntegerConstant(const Expr *Expression, const ASTContext *Context)
 
 static llvm::APInt getIntegerConstant(const Expr *Expression, const ASTContext *Context) {
   llvm::APSInt Result;
+  std::lock_guard<std::mutex> Lock(ConstantEvaluationMutex);
   if (Expression->EvaluateAsInt(Result, const_cast<ASTContext&>(*Context))) {
     return Result;
   }
@@ -3,6 +3,7 @@
 #include <exception>
 
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 
 #include "LoopClassifier.h"
 #include "ADT.h"
@@ -157,58 +158,103 @@ class IncrementClassifier : public LoopClassifier {
       }
     };
 
-    CheckBodyResult checkBody(const NaturalLoop *L, const IncrementInfo I) const throw () {
-#undef DEBUG_TYPE
-#define DEBUG_TYPE "checkBody"
-      const NaturalLoopBlock *Header = *L->getEntry().succ_begin();
-      LoopVariableFinder Finder(this);
+    typedef std::map<const VarDecl*, CheckBodyResult> CheckBodyResults;
+
+    /*
+     * Max/min number of increments and the accumulated increments of each
+     * candidate variable along the paths through L.
+     * Increments are collected in one traversal of each block for all
+     * candidates; per-block state is kept in arrays indexed by the block's
+     * position in L. Each variable still runs its own worklist, as the result
+     * depends on the order blocks are visited in.
+     */
+    CheckBodyResults checkBodies(const NaturalLoop *L, const std::set<IncrementInfo> &Candidates) const throw () {
+      std::vector<const NaturalLoopBlock*> Blocks(L->begin(), L->end());
+      llvm::DenseMap<const NaturalLoopBlock*, unsigned> BlockIndex;
+      for (unsigned B = 0; B < Blocks.size(); B++) {
+        BlockIndex[Blocks[B]] = B;
+      }
+      std::vector<const VarDecl*> Vars;
+      llvm::DenseMap<const VarDecl*, unsigned> VarIndex;
+      for (const IncrementInfo I : Candidates) {
+        if (VarIndex.insert(std::make_pair(I.VD, Vars.size())).second) {
+          Vars.push_back(I.VD);
+        }
+      }
 
-      std::map<const NaturalLoopBlock *, unsigned> IncrementCount;
-      std::map<const NaturalLoopBlock *, AugInt> AccumulatedIncrement;
-      for (auto Block : *L) {
-        for (const IncrementInfo Increment : Finder.findIncrements(Block)) {
-          if (Increment.VD == I.VD) {
-            IncrementCount[Block]++;
-            if (Increment.Delta.isInt()) {
-              AccumulatedIncrement[Block] += Increment.Delta.Int.getSExtValue();
-            } else {
-              AccumulatedIncrement[Block].setUnknown();
-            }
+      // [variable][block]
+      const unsigned NumBlocks = Blocks.size();
+      std::vector<unsigned> IncrementCount(Vars.size() * NumBlocks, 0);
+      std::vector<AugInt> AccumulatedIncrement(Vars.size() * NumBlocks);
+      LoopVariableFinder Finder(this);
+      for (unsigned B = 0; B < NumBlocks; B++) {
+        for (const IncrementInfo Increment : Finder.findIncrements(Blocks[B])) {
+          auto V = VarIndex.find(Increment.VD);
+          if (V == VarIndex.end()) continue;
+          const unsigned Index = V->second * NumBlocks + B;
+          IncrementCount[Index]++;
+          if (Increment.Delta.isInt()) {
+            AccumulatedIncrement[Index] += Increment.Delta.Int.getSExtValue();
+          } else {
+            AccumulatedIncrement[Index].setUnknown();
           }
         }
       }
 
-      std::map<const NaturalLoopBlock *, CheckBodyResult> In, Out;
+      CheckBodyResults Results;
+      for (unsigned V = 0; V < Vars.size(); V++) {
+        Results[Vars[V]] = checkBody(L, Blocks, BlockIndex,
+            &IncrementCount[V * NumBlocks], &AccumulatedIncrement[V * NumBlocks]);
+      }
+      return Results;
+    }
+
+    CheckBodyResult checkBody(
+        const NaturalLoop *L,
+        const std::vector<const NaturalLoopBlock*> &Blocks,
+        const llvm::DenseMap<const NaturalLoopBlock*, unsigned> &BlockIndex,
+        const unsigned *IncrementCount,
+        const AugInt *AccumulatedIncrement) const throw () {
+#undef DEBUG_TYPE
+#define DEBUG_TYPE "checkBody"
+      const NaturalLoopBlock *Header = *L->getEntry().succ_begin();
+      auto index = [&BlockIndex](const NaturalLoopBlock *Block) {
+        return BlockIndex.find(Block)->second;
+      };
+
+      std::vector<CheckBodyResult> In(Blocks.size()), Out(Blocks.size());
 
       // Initialize all blocks    (1) + (2)
-      std::stack<const NaturalLoopBlock*> Worklist;
-      for (auto Block : *L) {
+      std::stack<unsigned> Worklist;
+      for (unsigned B = 0; B < Blocks.size(); B++) {
+        const NaturalLoopBlock *Block = Blocks[B];
         /* Instead of initializing blocks with 0 and pushing them to the worklist,
          * anticipate the first iteration and push their successsors.
          * This way we don't need to compute f_HEADER(x) on the first iteration.
          */
-        Out[Block] = { IncrementCount[Block], IncrementCount[Block], { AccumulatedIncrement[Block] } };
+        Out[B] = { IncrementCount[B], IncrementCount[B], { AccumulatedIncrement[B] } };
         DEBUG(
           llvm::dbgs() << "init Out[" << Block->getBlockID() << "]: ";
-          for (auto X : Out[Block].AccumulatedIncrement)
+          for (auto X : Out[B].AccumulatedIncrement)
             llvm::dbgs() << X.str() << ",";
           llvm::dbgs() << "\n";
         );
-        if (IncrementCount[Block] or AccumulatedIncrement[Block].isUnknown() or AccumulatedIncrement[Block] != 0) {
+        if (IncrementCount[B] or AccumulatedIncrement[B].isUnknown() or AccumulatedIncrement[B] != 0) {
           for (NaturalLoopBlock::const_succ_iterator I = Block->succ_begin(),
                                                      E = Block->succ_end();
                                                      I != E; I++) {
             const NaturalLoopBlock *Succ = *I;
-            if (Succ) Worklist.push(Succ);
+            if (Succ) Worklist.push(index(Succ));
           }
         }
       }
 
-      std::set<const NaturalLoopBlock *> Visited;
+      std::vector<bool> Visited(Blocks.size(), false);
 
       // while OUT changes
       while (Worklist.size()) {
-        const NaturalLoopBlock *Block = Worklist.top();
+        const unsigned B = Worklist.top();
+        const NaturalLoopBlock *Block = Blocks[B];
         Worklist.pop();
 
         DEBUG( llvm::dbgs() << "Processing worklist item " << Block->getBlockID() << "\n" );
@@ -223,34 +269,29 @@ class IncrementClassifier : public LoopClassifier {
           const NaturalLoopBlock *Pred = *P;
           if (Pred == &L->getEntry()) continue;
           DEBUG( llvm::dbgs() << "propagation from WL item's pred " << Pred->getBlockID() << "\n" );
-          DEBUG(
-            llvm::dbgs() << "\tOut[" << Block->getBlockID() << "]: ";
-            for (auto X : Out[Block].AccumulatedIncrement)
-              llvm::dbgs() << X.str() << ",";
-            llvm::dbgs() << "\n";
-          );
-          max = Out[Pred].MaxAssignments > max ? Out[Pred].MaxAssignments : max;
-          min = Out[Pred].MinAssignments < min ? Out[Pred].MinAssignments : min;
-          allIncs.insert(Out[Pred].AccumulatedIncrement.begin(), Out[Pred].AccumulatedIncrement.end());
-        }
-        In[Block] = { max, min, allIncs };
+          const CheckBodyResult &PredOut = Out[index(Pred)];
+          max = PredOut.MaxAssignments > max ? PredOut.MaxAssignments : max;
+          min = PredOut.MinAssignments < min ? PredOut.MinAssignments : min;
+          allIncs.insert(PredOut.AccumulatedIncrement.begin(), PredOut.AccumulatedIncrement.end());
+        }
+        In[B] = { max, min, allIncs };
 
         DEBUG(
           llvm::dbgs() << "In[" << Block->getBlockID() << "]: ";
-          for (auto X : In[Block].AccumulatedIncrement)
+          for (auto X : In[B].AccumulatedIncrement)
             llvm::dbgs() << X.str() << ",";
           llvm::dbgs() << "\n";
         );
 
         if (Block == Header) continue;
 
-        Visited.insert(Block);
+        Visited[B] = true;
         bool loop = false;
         for (NaturalLoopBlock::const_succ_iterator I = Block->succ_begin(),
                                                    E = Block->succ_end();
                                                    I != E; I++) {
           const NaturalLoopBlock *Succ = *I;
-          if (Visited.count(Succ)) {
+          if (Succ and Visited[index(Succ)]) {
             loop = true;
           }
         }
@@ -261,42 +302,43 @@ class IncrementClassifier : public LoopClassifier {
           allIncsOut = { AugInt::UnknownAugInt() };
         } else {
           for (auto incIn : allIncs) {
-            allIncsOut.insert(incIn + AccumulatedIncrement[Block]);
+            allIncsOut.insert(incIn + AccumulatedIncrement[B]);
           }
         }
-        unsigned n = IncrementCount[Block];
+        unsigned n = IncrementCount[B];
         CheckBodyResult NewOut = {  // (6)
-          std::min(2u, In[Block].MaxAssignments + n),
-          std::min(2u, In[Block].MinAssignments + n),
+          std::min(2u, In[B].MaxAssignments + n),
+          std::min(2u, In[B].MinAssignments + n),
           allIncsOut
         };
 
-        if (Out[Block] != NewOut) {
+        if (Out[B] != NewOut) {
           for (NaturalLoopBlock::const_succ_iterator I = Block->succ_begin(),
                                                      E = Block->succ_end();
                                                      I != E; I++) {
             const NaturalLoopBlock *Succ = *I;
-            if (Succ) Worklist.push(Succ);
+            if (Succ) Worklist.push(index(Succ));
           }
         }
 
-        Out[Block] = NewOut;
+        Out[B] = NewOut;
 
         DEBUG(
           llvm::dbgs() << "Out[" << Block->getBlockID() << "]: ";
-          for (auto X : Out[Block].AccumulatedIncrement)
+          for (auto X : Out[B].AccumulatedIncrement)
             llvm::dbgs() << X.str() << ",";
           llvm::dbgs() << "\n";
         );
       }
+      const unsigned H = index(Header);
       DEBUG(
         llvm::dbgs() << "----\nIn[Header]: ";
-        for (auto X : In[Header].AccumulatedIncrement)
+        for (auto X : In[H].AccumulatedIncrement)
           llvm::dbgs() << X.str() << ",";
         llvm::dbgs() << "\n===\n";
       );
 
-      return In[Header];
+      return In[H];
 #undef DEBUG_TYPE
 #define DEBUG_TYPE ""
     }
@@ -323,12 +365,13 @@ class IncrementClassifier : public LoopClassifier {
       DEBUG( llvm::dbgs() << "Number of loop var candidates: " << LoopVarCandidates.size() << "\n"; );
 
       InvariantVarFinder F(Loop);
+      CheckBodyResults Bodies = checkBodies(Loop, LoopVarCandidates);
 
       // restrict loop var candidates to those incremented on each path
       std::set<IncrementInfo> LoopVarCandidatesEachPath;
       for (const IncrementInfo I : LoopVarCandidates) {
         DEBUG( llvm::dbgs() << "Checking candidate " << I.VD->getNameAsString() << "... " );
-        auto MaxMin = checkBody(Loop, I);
+        const CheckBodyResult &MaxMin = Bodies[I.VD];
         if (MaxMin.MinAssignments < 1) {
           // there must be >= 1 assignments on each path
           continue;
@@ -363,6 +406,8 @@ class IncrementClassifier : public LoopClassifier {
 
       std::set<const NaturalLoopBlock*> ProvablyTerminatingBlocks;
       std::map<const NaturalLoopBlock*, llvm::BitVector> AssumptionMap;
+      // each exit condition is converted to z3 once for all candidates
+      Z3ConditionCache Conditions;
       // find provably terminating blocks
       for (NaturalLoopBlock::const_pred_iterator PI = Loop->getExit().pred_begin(),
                                                  PE = Loop->getExit().pred_end();
@@ -402,18 +447,18 @@ class IncrementClassifier : public LoopClassifier {
         for (const IncrementInfo I : LoopVarCandidatesEachPath) {
           LinearHelper H;
 
-          auto MaxMin = checkBody(Loop, I);
+          const CheckBodyResult &MaxMin = Bodies[I.VD];
           DEBUG( llvm::dbgs() << "\t- " << I.VD->getNameAsString() << " IncrementSize: " << MaxMin.AccumulatedIncrement.size() << "\n" );
 
           // see if we can find a proof
           if (whichBranch == 1) {
             // cond needs to become false to exit the loop
-            if (not H.dropsToZero(I.VD, Cond, MaxMin.AccumulatedIncrement, false, assumeImplies)) {
+            if (not H.dropsToZero(I.VD, Cond, MaxMin.AccumulatedIncrement, false, assumeImplies, Conditions)) {
               continue;
             }
           } else if (whichBranch == 0) {
             // cond needs to become true to exit the loop
-            if (not H.dropsToZero(I.VD, Cond, MaxMin.AccumulatedIncrement, true, assumeImplies)) {
+            if (not H.dropsToZero(I.VD, Cond, MaxMin.AccumulatedIncrement, true, assumeImplies, Conditions)) {
               continue;
             }
           } else {
@@ -469,6 +514,11 @@ class IncrementClassifier : public LoopClassifier {
           return std::set<IncrementLoopInfo>();
         }
 
+        CheckBodyResults Bodies;
+        if (Constr.IConstr == EACH_PATH) {
+          Bodies = checkBodies(Loop, LoopVarCandidates);
+        }
+
         std::set<std::string> Reasons;  // why the (IncrementInfo, Cond) pairs aren't wellformed
         std::set<IncrementLoopInfo> WellformedIncrements;
         std::set<std::string> Suffixes;
@@ -482,7 +532,7 @@ class IncrementClassifier : public LoopClassifier {
 
               // increments on each path?
               if (Constr.IConstr == EACH_PATH) {
-                auto pair = checkBody(Loop, I);
+                const CheckBodyResult &pair = Bodies[I.VD];
                 if (pair.MaxAssignments > 1)
                     throw checkerror("ASSIGNED_Twice");
                 if (pair.MinAssignments < 1)
@@ -28,3 +28,19 @@ llvm::cl::opt<unsigned> Line("line");
 llvm::cl::opt<bool> DumpZ3("dump-z3");
 llvm::cl::opt<bool> EnableAmortized("enable-amortized");
 llvm::cl::opt<bool> Psyntterm_only("Psyntterm-only");
+llvm::cl::opt<bool> ReuseFingerprints("reuse-fingerprints");
+llvm::cl::opt<unsigned> VerifyFingerprints("verify-fingerprints", llvm::cl::init(0));
+llvm::cl::opt<unsigned> Jobs("j", llvm::cl::init(1));
+llvm::cl::opt<std::string> Shard("shard");
+llvm::cl::opt<bool> MachineLearningRaw("ml-raw");
+llvm::cl::opt<std::string> FeaturesCSV("features-csv");
+llvm::cl::opt<std::string> FeaturesBinary("features-bin");
+llvm::cl::opt<bool> Server("server");
+llvm::cl::opt<std::string> ServerSocket("server-socket");
+llvm::cl::opt<unsigned> ServerCache("server-cache", llvm::cl::init(16));
+llvm::cl::opt<bool> Progress("progress");
+llvm::cl::opt<std::string> ProgressFile("progress-file");
+llvm::cl::opt<unsigned> ProgressInterval("progress-interval", llvm::cl::init(10));
+llvm::cl::opt<unsigned> MaxCFGBlocks("max-cfg-blocks", llvm::cl::init(0));
+llvm::cl::opt<unsigned> MaxLoopBlocks("max-loop-blocks", llvm::cl::init(0));
+llvm::cl::opt<std::string> MemoryStats("memory-stats");
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "Classifier.h"
+
+namespace sloopy {
+
+// the proving constraints in the order Classifier runs them
+static const SimpleLoopConstraint FeatureProvingConstraints[] = {
+  SyntacticTerm,
+  AnyExitProvedCfTerminating,
+  AnyExitStrongCfTerminating,
+  AnyExitWeakCfTerminating,
+  AnyExitProvedCfWellformed,
+  AnyExitStrongCfWellformed,
+  AnyExitWeakCfWellformed,
+  SingleExitProvedCfTerminating,
+  SingleExitStrongCfTerminating,
+  SingleExitWeakCfTerminating,
+  SingleExitProvedCfWellformed,
+  SingleExitStrongCfWellformed,
+  SingleExitWeakCfWellformed,
+  AnyExitStrongCfInvariantTerminating,
+  AnyExitWeakCfInvariantTerminating,
+  AnyExitProvedCfInvariantWellformed,
+  AnyExitStrongCfInvariantWellformed,
+  AnyExitWeakCfInvariantWellformed,
+  SingleExitProvedCfInvariantTerminating,
+  SingleExitStrongCfInvariantTerminating,
+  SingleExitWeakCfInvariantTerminating,
+  SingleExitProvedCfInvariantWellformed,
+  SingleExitStrongCfInvariantWellformed,
+  SingleExitWeakCfInvariantWellformed,
+};
+static const unsigned NumFeatureProvingConstraints =
+  sizeof(FeatureProvingConstraints) / sizeof(FeatureProvingConstraints[0]);
+
+static const IncrementClassifierConstraint FeatureIncrementConstraints[] = {
+  SingleExit,
+  StrongSingleExit,
+  MultiExit,
+  StrongMultiExit,
+};
+static const unsigned NumFeatureIncrementConstraints =
+  sizeof(FeatureIncrementConstraints) / sizeof(FeatureIncrementConstraints[0]);
+
+// the assumptions MasterProvingClassifier records for Proved, by bit
+static const char *const FeatureAssumptions[] = {
+  "Wrapv",
+  "LeBoundNotMax",
+  "GeBoundNotMin",
+  "MNeq0",
+  "WrapvOrRunsInto",
+  "RightArrayContent",
+};
+static const unsigned NumFeatureAssumptions =
+  sizeof(FeatureAssumptions) / sizeof(FeatureAssumptions[0]);
+
+/*
+ * Per-loop feature vector, as written to the binary export.
+ * Fixed width and naturally aligned, so the file (a LoopFeatureFileHeader
+ * followed by records) can be memory-mapped as an array. Byte order is the
+ * host's. Classes a run didn't compute (e.g. under -ml) are NotClassified.
+ */
+struct LoopFeatureRecord {
+  static const uint8_t NotClassified = 0xff;
+  static const uint32_t NoCounters = 0xffffffff;
+
+  uint64_t Fingerprint;
+  uint32_t CFGBlocks;
+  uint32_t Exits;
+  uint32_t Depth;
+  uint32_t Counters[NumFeatureIncrementConstraints];
+  uint8_t TriviallyNonterminating;
+  uint8_t FinitePaths;
+  // bit i: Proved needs assumption i; NotClassified if not Proved
+  uint8_t Assumptions;
+  uint8_t Verdicts[NumFeatureProvingConstraints];
+  uint8_t Padding[1];
+};
+static_assert(sizeof(LoopFeatureRecord) == 64, "the binary layout is fixed");
+
+struct LoopFeatureFileHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t RecordSize;
+};
+
+/* A loop's features and its location, which only goes to the CSV. */
+struct LoopFeatures {
+  std::string Location;
+  LoopFeatureRecord Record;
+
+  static int getInt(const ClassificationProperty &P, const std::string &Name, int Default) {
+    auto I = P.find(Name);
+    if (I == P.end()) return Default;
+    if (const int *V = boost::get<int>(&I->second)) return *V;
+    if (const unsigned *V = boost::get<unsigned>(&I->second)) return *V;
+    return Default;
+  }
+
+  static uint32_t getCounters(const ClassificationProperty &P, const std::string &Name) {
+    auto I = P.find(Name);
+    if (I == P.end()) return LoopFeatureRecord::NoCounters;
+    const IncrementClassificationValue *ICV = boost::get<IncrementClassificationValue>(&I->second);
+    if (!ICV) return LoopFeatureRecord::NoCounters;
+    auto C = ICV->find("Counters");
+    if (C == ICV->end()) return LoopFeatureRecord::NoCounters;
+    if (const unsigned *V = boost::get<unsigned>(&C->second)) return *V;
+    return LoopFeatureRecord::NoCounters;
+  }
+
+  LoopFeatures(const std::string &Location, const NaturalLoop *Unsliced,
+               unsigned Depth, const ClassificationProperty &P) : Location(Location) {
+    std::memset(&Record, 0, sizeof(Record));
+
+    auto FP = P.find("Fingerprint");
+    if (FP != P.end()) {
+      if (const std::string *S = boost::get<std::string>(&FP->second)) {
+        Record.Fingerprint = std::strtoull(S->c_str(), NULL, 16);
+      }
+    }
+    Record.CFGBlocks = Unsliced->size();
+    Record.Exits = Unsliced->getExit().pred_size();
+    Record.Depth = Depth;
+    for (unsigned I = 0; I < NumFeatureIncrementConstraints; I++) {
+      Record.Counters[I] = getCounters(P, FeatureIncrementConstraints[I].str());
+    }
+    Record.TriviallyNonterminating = getInt(P, "TriviallyNonterminating", 0);
+    Record.FinitePaths = getInt(P, "FinitePaths", 0);
+
+    Record.Assumptions = LoopFeatureRecord::NotClassified;
+    if (P.count(SyntacticTerm.str()+"WithoutAssumptions")) {
+      Record.Assumptions = 0;
+      for (unsigned I = 0; I < NumFeatureAssumptions; I++) {
+        if (getInt(P, SyntacticTerm.str()+"WithAssumption"+FeatureAssumptions[I], 0)) {
+          Record.Assumptions |= 1 << I;
+        }
+      }
+    }
+    for (unsigned I = 0; I < NumFeatureProvingConstraints; I++) {
+      Record.Verdicts[I] = getInt(P, FeatureProvingConstraints[I].str(), LoopFeatureRecord::NotClassified);
+    }
+  }
+};
+
+/*
+ * Streams loop features to -features-csv and/or -features-bin as functions
+ * are analyzed.
+ */
+class LoopFeatureWriter {
+  llvm::raw_ostream *CSV;
+  llvm::raw_ostream *Binary;
+
+  static void printCounter(llvm::raw_ostream &OS, uint32_t Value) {
+    if (Value == LoopFeatureRecord::NoCounters) return;
+    OS << Value;
+  }
+  static void printFlag(llvm::raw_ostream &OS, uint8_t Value) {
+    if (Value == LoopFeatureRecord::NotClassified) return;
+    OS << (unsigned)Value;
+  }
+
+  public:
+    LoopFeatureWriter(llvm::raw_ostream *CSV, llvm::raw_ostream *Binary) : CSV(CSV), Binary(Binary) {
+      if (CSV) {
+        *CSV << "location,fingerprint,cfgblocks,exits,depth";
+        for (unsigned I = 0; I < NumFeatureIncrementConstraints; I++) {
+          *CSV << "," << FeatureIncrementConstraints[I].str() << "Counters";
+        }
+        *CSV << ",TriviallyNonterminating,FinitePaths";
+        for (unsigned I = 0; I < NumFeatureAssumptions; I++) {
+          *CSV << "," << SyntacticTerm.str() << "WithAssumption" << FeatureAssumptions[I];
+        }
+        for (unsigned I = 0; I < NumFeatureProvingConstraints; I++) {
+          *CSV << "," << FeatureProvingConstraints[I].str();
+        }
+        *CSV << "\n";
+      }
+      if (Binary) {
+        LoopFeatureFileHeader Header = { { 'S', 'L', 'O', 'O', 'P', 'Y', 'F', 'V' }, 1, sizeof(LoopFeatureRecord) };
+        Binary->write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+      }
+    }
+
+    void write(const LoopFeatures &F) {
+      if (CSV) {
+        const LoopFeatureRecord &R = F.Record;
+        // locations contain no quotes, but may contain commas
+        *CSV << "\"" << F.Location << "\",";
+        CSV->write_hex(R.Fingerprint);
+        *CSV << "," << R.CFGBlocks << "," << R.Exits << "," << R.Depth;
+        for (unsigned I = 0; I < NumFeatureIncrementConstraints; I++) {
+          *CSV << ",";
+          printCounter(*CSV, R.Counters[I]);
+        }
+        *CSV << "," << (unsigned)R.TriviallyNonterminating << "," << (unsigned)R.FinitePaths;
+        for (unsigned I = 0; I < NumFeatureAssumptions; I++) {
+          *CSV << ",";
+          if (R.Assumptions != LoopFeatureRecord::NotClassified) {
+            *CSV << ((R.Assumptions >> I) & 1);
+          }
+        }
+        for (unsigned I = 0; I < NumFeatureProvingConstraints; I++) {
+          *CSV << ",";
+          printFlag(*CSV, R.Verdicts[I]);
+        }
+        *CSV << "\n";
+      }
+      if (Binary) {
+        Binary->write(reinterpret_cast<const char *>(&F.Record), sizeof(F.Record));
+      }
+    }
+};
+
+} // end namespace sloopy
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <iomanip>
+#include <sstream>
+#include <stack>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "clang/AST/StmtVisitor.h"
+
+#include "Loop.h"
+
+using namespace clang;
+
+namespace sloopy {
+
+/*
+ * Structural hash of a loop (and its slices): block shape, terminator
+ * condition shapes and statement shapes, including types and literal values,
+ * with variables, functions and fields alpha-renamed in order of first
+ * occurrence.
+ * Loops with equal fingerprints are classified identically, e.g. the
+ * expansions of a list_for_each-style macro.
+ */
+class LoopFingerprint : public ConstStmtVisitor<LoopFingerprint> {
+  public:
+    typedef uint64_t hash_type;
+
+  private:
+    std::vector<unsigned> Data;
+    llvm::DenseMap<const Decl*, unsigned> DeclIDs;
+    std::map<std::string, unsigned> NameIDs;
+    // hashes of the canonical type spellings seen so far
+    llvm::DenseMap<const void*, hash_type> TypeHashes;
+    hash_type Hash;
+
+    void add(unsigned Value) {
+      Data.push_back(Value);
+    }
+    void add64(uint64_t Value) {
+      add(Value);
+      add(Value >> 32);
+    }
+    void addString(StringRef S) {
+      add(S.size());
+      add64(llvm::hash_value(S));
+    }
+
+    // the spelling covers pointee, element and record types and qualifiers
+    void addType(QualType T) {
+      if (T.isNull()) {
+        add(0);
+        return;
+      }
+      QualType Canonical = T.getCanonicalType();
+      add(Canonical->getTypeClass());
+      auto I = TypeHashes.find(Canonical.getAsOpaquePtr());
+      if (I == TypeHashes.end()) {
+        hash_type H = llvm::hash_value(StringRef(Canonical.getAsString()));
+        I = TypeHashes.insert({ Canonical.getAsOpaquePtr(), H }).first;
+      }
+      add64(I->second);
+    }
+
+    // alpha-renaming: the n-th distinct declaration is represented by n
+    void addDecl(const Decl *D) {
+      if (D == NULL) {
+        add(0);
+        return;
+      }
+      add(D->getKind());
+      auto I = DeclIDs.find(D);
+      if (I != DeclIDs.end()) {
+        add(I->second);
+        return;
+      }
+      unsigned ID = DeclIDs.size() + 1;
+      DeclIDs[D] = ID;
+      add(ID);
+
+      // first occurrence: record what the classifiers look at
+      if (const NamedDecl *ND = dyn_cast<NamedDecl>(D)) {
+        // z3 constants are named after the variable, so shadowing matters
+        std::string Name = ND->getNameAsString();
+        auto N = NameIDs.find(Name);
+        if (N == NameIDs.end()) {
+          N = NameIDs.insert({ Name, NameIDs.size() + 1 }).first;
+        }
+        add(N->second);
+      }
+      if (const ValueDecl *VD = dyn_cast<ValueDecl>(D)) {
+        addType(VD->getType());
+      }
+      if (const VarDecl *VD = dyn_cast<VarDecl>(D)) {
+        add(VD->hasLocalStorage());
+      }
+      if (const EnumConstantDecl *ECD = dyn_cast<EnumConstantDecl>(D)) {
+        add64(ECD->getInitVal().getSExtValue());
+      }
+    }
+
+    void addStmt(const Stmt *S) {
+      if (S == NULL) {
+        add(0);
+        return;
+      }
+      add(S->getStmtClass());
+      if (const Expr *E = dyn_cast<Expr>(S)) {
+        addType(E->getType());
+      }
+      Visit(S);
+      unsigned Children = 0;
+      for (Stmt::const_child_iterator I = S->child_begin(),
+                                      E = S->child_end();
+                                      I != E; ++I) {
+        Children++;
+      }
+      add(Children);
+      for (Stmt::const_child_iterator I = S->child_begin(),
+                                      E = S->child_end();
+                                      I != E; ++I) {
+        addStmt(*I);
+      }
+    }
+
+    void addShallow(const Stmt *S) {
+      if (S == NULL) {
+        add(0);
+        return;
+      }
+      add(S->getStmtClass());
+      Visit(S);
+    }
+
+    void addLoop(const NaturalLoop *Loop) {
+      add(Loop->getLoopStmt()->getStmtClass());
+      add(Loop->size());
+      add(Loop->getControlVars().size());
+
+      // number blocks in DFS order from ENTRY; the block list itself is
+      // ordered by CFG block ID, which depends on how the CFG was built
+      // rather than on the shape of the loop
+      std::map<const NaturalLoopBlock*, unsigned> BlockIDs;
+      std::vector<const NaturalLoopBlock*> Order;
+      std::stack<const NaturalLoopBlock*> Worklist;
+      Worklist.push(&Loop->getEntry());
+      while (Worklist.size()) {
+        const NaturalLoopBlock *Block = Worklist.top();
+        Worklist.pop();
+        if (not BlockIDs.insert({ Block, BlockIDs.size() + 1 }).second) continue;
+        Order.push_back(Block);
+        for (NaturalLoopBlock::const_succ_iterator I = Block->succ_end(),
+                                                   E = Block->succ_begin();
+                                                   I != E; ) {
+          const NaturalLoopBlock *Succ = *--I;
+          if (Succ) Worklist.push(Succ);
+        }
+      }
+      for (auto Block : *Loop) {
+        if (BlockIDs.insert({ Block, BlockIDs.size() + 1 }).second) {
+          Order.push_back(Block);
+        }
+      }
+
+      for (auto Block : Order) {
+        add(Block == &Loop->getEntry() ? 1 : (Block == &Loop->getExit() ? 2 : 3));
+        // labels and terminators contain their sub-statements, which are
+        // hashed with the blocks they belong to
+        addShallow(Block->getLabel());
+        add(std::distance(Block->begin(), Block->end()));
+        for (auto S : *Block) {
+          addStmt(S);
+        }
+        addShallow(Block->getTerminator().getStmt());
+        addStmt(Block->getTerminatorCondition());
+        add(Block->succ_size());
+        for (NaturalLoopBlock::const_succ_iterator I = Block->succ_begin(),
+                                                   E = Block->succ_end();
+                                                   I != E; I++) {
+          add(*I ? BlockIDs[*I] : 0);
+        }
+        add(Block->pred_size());
+      }
+    }
+
+  public:
+    LoopFingerprint(
+        const NaturalLoop *Unsliced,
+        const NaturalLoop *SlicedAllLoops,
+        const NaturalLoop *SlicedOuterLoop) {
+      // one renaming across all three graphs, so slices are compared
+      // against the same variables
+      addLoop(Unsliced);
+      addLoop(SlicedAllLoops);
+      addLoop(SlicedOuterLoop);
+      Hash = llvm::hash_combine_range(Data.begin(), Data.end());
+    }
+
+    hash_type getHash() const { return Hash; }
+
+    std::string str() const {
+      std::stringstream sstm;
+      sstm << std::hex << std::setw(16) << std::setfill('0') << Hash;
+      return sstm.str();
+    }
+
+    void VisitDeclRefExpr(const DeclRefExpr *E) {
+      addDecl(E->getDecl());
+    }
+    void VisitMemberExpr(const MemberExpr *E) {
+      add(E->isArrow());
+      addDecl(E->getMemberDecl());
+    }
+    void VisitDeclStmt(const DeclStmt *S) {
+      for (DeclStmt::const_decl_iterator I = S->decl_begin(),
+                                         E = S->decl_end();
+                                         I != E; I++) {
+        addDecl(*I);
+      }
+    }
+    void VisitLabelStmt(const LabelStmt *S) {
+      addDecl(S->getDecl());
+    }
+    void VisitGotoStmt(const GotoStmt *S) {
+      addDecl(S->getLabel());
+    }
+    void VisitBinaryOperator(const BinaryOperator *E) {
+      add(E->getOpcode());
+    }
+    void VisitUnaryOperator(const UnaryOperator *E) {
+      add(E->getOpcode());
+    }
+    void VisitCastExpr(const CastExpr *E) {
+      add(E->getCastKind());
+    }
+    void VisitIntegerLiteral(const IntegerLiteral *E) {
+      add64(E->getValue().getLimitedValue());
+    }
+    void VisitCharacterLiteral(const CharacterLiteral *E) {
+      add(E->getValue());
+    }
+    void VisitFloatingLiteral(const FloatingLiteral *E) {
+      add64(llvm::hash_value(E->getValue().bitcastToAPInt()));
+    }
+    void VisitStringLiteral(const StringLiteral *E) {
+      add(E->getKind());
+      addString(E->getBytes());
+    }
+    void VisitUnaryExprOrTypeTraitExpr(const UnaryExprOrTypeTraitExpr *E) {
+      add(E->getKind());
+      addType(E->getTypeOfArgument());
+      if (E->isArgumentType()) {
+        // sizeof(T) is folded by the increment classifiers
+        addType(E->getArgumentType());
+      }
+    }
+    void VisitStmt(const Stmt *S) {}
+};
+
+} // end namespace sloopy
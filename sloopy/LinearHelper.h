@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <stdexcept>
 
 #include "llvm/ADT/BitVector.h"
@@ -9,6 +10,7 @@
 #include "z3++.h"
 
 #include "CmdLine.h"
+#include "Memory.h"
 
 using namespace clang;
 
@@ -166,6 +168,10 @@ namespace sloopy {
         Deref(Ctx->function("__SLOOPY__Deref", Ctx->int_sort(), Ctx->int_sort())),
         NextExpression(NextExpression) {}
 
+      ~Z3Converter() {
+        if (Ctx) sampleZ3Memory();
+      }
+
       std::set<const VarDecl*> getConstants() {
         std::set<const VarDecl*> Result;
         for (auto Pair : MapClangZ3) {
@@ -174,6 +180,14 @@ namespace sloopy {
         return Result;
       }
 
+      const std::map<const VarDecl*, z3::expr> &getVariables() const {
+        return MapClangZ3;
+      }
+
+      z3::context &context() {
+        return *Ctx;
+      }
+
       z3::context *take() {
         return Ctx.take();
       }
@@ -374,6 +388,48 @@ namespace sloopy {
       }
     };
 
+    /*
+     * Conditions converted to z3 in one shared context, e.g. the exit
+     * conditions of a loop, which are checked against every candidate
+     * variable. Creating a z3::context per check dominated classifyProve.
+     */
+    class Z3ConditionCache {
+      public:
+        struct Condition {
+          z3::expr E;
+          std::map<const VarDecl*, z3::expr> Variables;
+
+          const VarDecl *exprFor(const z3::expr &expr) const {
+            for (auto Pair : Variables) {
+              if (eq(Pair.second, expr)) {
+                return Pair.first;
+              }
+            }
+            llvm_unreachable("expr not in map");
+          }
+        };
+
+      private:
+        Z3Converter Z3C;
+        // NULL if the condition can't be converted
+        std::map<const Expr*, std::unique_ptr<Condition>> Conditions;
+
+      public:
+        const Condition *get(const Expr *E) {
+          auto I = Conditions.find(E);
+          if (I != Conditions.end()) return I->second.get();
+
+          Condition *C = NULL;
+          try {
+            z3::expr z3E = Z3C.Run(E);
+            C = new Condition { z3E, Z3C.getVariables() };
+          } catch (exception) {
+          }
+          Conditions[E].reset(C);
+          return C;
+        }
+    };
+
     enum Monotonicity {
       NotMonotone,        // not monotone
       Constant,           // constant
@@ -730,9 +786,16 @@ namespace sloopy {
       }
 
       bool dropsToZero(const VarDecl *X, const Expr *E, const IncrementSet Increments, const bool negate, const bool assumeImplies) {
-        Z3Converter Z3C;
+        Z3ConditionCache Conditions;
+        return dropsToZero(X, E, Increments, negate, assumeImplies, Conditions);
+      }
+
+      bool dropsToZero(const VarDecl *X, const Expr *E, const IncrementSet Increments, const bool negate, const bool assumeImplies,
+                       Z3ConditionCache &Conditions) {
+        const Z3ConditionCache::Condition *C = Conditions.get(E);
+        if (!C) return false;
         try {
-          z3::expr z3E = Z3C.Run(E);
+          z3::expr z3E = C->E;
           if (negate) {
             if (not z3E.is_bool()) {
               z3E = z3E == 0;
@@ -740,20 +803,21 @@ namespace sloopy {
             z3E = !z3E;
           }
           DEBUG_WITH_TYPE("z3", llvm::dbgs() << "drops to zero? " << z3E << "\n");
-          try {
-            z3::expr z3X = Z3C.exprFor(X);
-            Constants = Z3C.getConstants();
-            bool Result = dropsToZero(z3X, z3E, Increments, assumeImplies);
-            for (auto expr : Z3AssumeWrapv) {
-              AssumeWrapv.insert(Z3C.exprFor(*expr));
-            }
-            for (auto expr : Z3AssumeWrapvOrRunsInto) {
-              AssumeWrapvOrRunsInto.insert(Z3C.exprFor(*expr));
-            }
-            return Result;
-          } catch (std::out_of_range) {
-            return false;
+          auto I = C->Variables.find(X);
+          if (I == C->Variables.end()) return false;
+          z3::expr z3X = I->second;
+          Constants.clear();
+          for (auto Pair : C->Variables) {
+            Constants.insert(Pair.first);
+          }
+          bool Result = dropsToZero(z3X, z3E, Increments, assumeImplies);
+          for (auto expr : Z3AssumeWrapv) {
+            AssumeWrapv.insert(C->exprFor(*expr));
+          }
+          for (auto expr : Z3AssumeWrapvOrRunsInto) {
+            AssumeWrapvOrRunsInto.insert(C->exprFor(*expr));
           }
+          return Result;
         } catch (exception) {
           return false;
         }
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "llvm/ADT/BitVector.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/GraphWriter.h"
 #include "clang/AST/PrettyPrinter.h"
 #include "clang/AST/StmtVisitor.h"
 
+#include "Memory.h"
+
 using namespace clang;
 
 namespace sloopy {
@@ -21,17 +24,127 @@ bool isTransitionBlock(const BlockT *Block) {
   return false;
 }
 
+/*
+ * The blocks of a CFG by ID. Block IDs are dense, so sets of blocks of one
+ * CFG are bit vectors (CFGBlockSet) that map IDs back through this table.
+ */
+class CFGBlockIndex {
+  std::vector<const CFGBlock*> Blocks;
+  public:
+    CFGBlockIndex(const CFG &G) : Blocks(G.getNumBlockIDs(), nullptr) {
+      for (CFG::const_iterator I = G.begin(), E = G.end(); I != E; I++) {
+        Blocks[(*I)->getBlockID()] = *I;
+      }
+    }
+    unsigned size() const { return Blocks.size(); }
+    const CFGBlock *operator[](unsigned ID) const { return Blocks[ID]; }
+};
+
+/*
+ * Presumed locations of the statements that identify loops: the loop
+ * targets, terminators and labels of the blocks of a CFG. Looking locations
+ * up fills caches of the SourceManager, so with -j the table is built on the
+ * main thread before the function is handed to a worker.
+ */
+class StmtLocations {
+  std::map<const Stmt*, PresumedLoc> Locations;
+
+  void add(const Stmt *S, const SourceManager &SM) {
+    if (S) Locations[S] = SM.getPresumedLoc(S->getSourceRange().getBegin());
+  }
+  public:
+    StmtLocations() {}
+    StmtLocations(const CFG &G, const SourceManager &SM) {
+      for (CFG::const_iterator I = G.begin(), E = G.end(); I != E; I++) {
+        add((*I)->getLoopTarget(), SM);
+        add((*I)->getTerminator().getStmt(), SM);
+        add((*I)->getLabel(), SM);
+      }
+    }
+    PresumedLoc operator[](const Stmt *S) const {
+      auto I = Locations.find(S);
+      assert(I != Locations.end() && "statement of no CFG block");
+      return I->second;
+    }
+};
+
+/*
+ * A set of blocks of one CFG, iterated in block ID order. Union and inclusion
+ * are word-level operations; both sets must share the CFGBlockIndex.
+ */
+class CFGBlockSet {
+  const CFGBlockIndex *Index;
+  llvm::BitVector Bits;
+  public:
+    CFGBlockSet() : Index(nullptr) {}
+    explicit CFGBlockSet(const CFGBlockIndex &Index) : Index(&Index), Bits(Index.size()) {}
+
+    const CFGBlockIndex &getIndex() const { return *Index; }
+
+    /* Returns whether B was not in the set. */
+    bool insert(const CFGBlock *B) {
+      unsigned ID = B->getBlockID();
+      if (Bits.test(ID)) return false;
+      Bits.set(ID);
+      return true;
+    }
+    unsigned count(const CFGBlock *B) const {
+      unsigned ID = B->getBlockID();
+      return ID < Bits.size() and Bits.test(ID);
+    }
+    unsigned size() const { return Bits.count(); }
+    bool empty() const { return Bits.none(); }
+    Allocations allocations() const {
+      Allocations A;
+      A.addBlock((Bits.size() + 7) / 8);
+      return A;
+    }
+
+    CFGBlockSet &operator|=(const CFGBlockSet &Other) {
+      assert(Index == Other.Index);
+      Bits |= Other.Bits;
+      return *this;
+    }
+    /* Returns whether Other is a subset of this set. */
+    bool includes(const CFGBlockSet &Other) const {
+      assert(Index == Other.Index);
+      return not Other.Bits.test(Bits);
+    }
+    bool operator==(const CFGBlockSet &Other) const {
+      return Index == Other.Index and Bits == Other.Bits;
+    }
+
+    class const_iterator {
+      const CFGBlockSet *Set;
+      int ID;
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef const CFGBlock *value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const CFGBlock *const *pointer;
+        typedef const CFGBlock *reference;
+
+        const_iterator(const CFGBlockSet *Set, int ID) : Set(Set), ID(ID) {}
+        const CFGBlock *operator*() const { return (*Set->Index)[ID]; }
+        const_iterator &operator++() { ID = Set->Bits.find_next(ID); return *this; }
+        bool operator==(const const_iterator &Other) const { return ID == Other.ID; }
+        bool operator!=(const const_iterator &Other) const { return ID != Other.ID; }
+    };
+    const_iterator begin() const { return const_iterator(this, Bits.find_first()); }
+    const_iterator end() const { return const_iterator(this, -1); }
+};
+
 class MergedLoopDescriptor {
   public:
   const CFGBlock *Header;
-  std::set<const CFGBlock*> Tails;
-  std::set<const CFGBlock*> Body;
+  CFGBlockSet Tails;
+  CFGBlockSet Body;
   std::vector<const MergedLoopDescriptor*> NestedLoops, ProperlyNestedLoops, NestingLoops;
   const bool IsTriviallyNonterminating;
   MergedLoopDescriptor(
     const CFGBlock *Header,
-    std::set<const CFGBlock*> Tails,
-    std::set<const CFGBlock*> Body,
+    const CFGBlockSet &Tails,
+    const CFGBlockSet &Body,
     const bool IsTriviallyNonterminating) : Header(Header), Tails(Tails), Body(Body), IsTriviallyNonterminating(IsTriviallyNonterminating) {}
   void addNestedLoop(MergedLoopDescriptor *D) {
     NestedLoops.push_back(D);
@@ -48,12 +161,12 @@ class MergedLoopDescriptor {
 };
 struct LoopDescriptor {
   const CFGBlock *Header, *Tail;
-  std::set<const CFGBlock*> Body;
+  CFGBlockSet Body;
   const bool IsTriviallyNonterminating;
 };
 struct SlicingCriterion {
   const std::set<const VarDecl*> Vars;
-  const std::set<const CFGBlock*> Locations;
+  const CFGBlockSet Locations;
 };
 
 class NaturalLoopBlock;
@@ -63,7 +176,7 @@ class NaturalLoop {
     NaturalLoopBlock *Entry, *Exit;
     std::list<NaturalLoopBlock*> Blocks;
     std::set<const VarDecl*> ControlVars;
-    std::set<const CFGBlock*> Tails;
+    CFGBlockSet Tails;
     const Stmt *LoopStmt;
     std::string Identifier;
     const NaturalLoop *Unsliced;
@@ -71,15 +184,17 @@ class NaturalLoop {
     ~NaturalLoop();
     void build(
         const CFGBlock *Header,
-        const std::set<const CFGBlock*> Tails,
-        const std::set<const CFGBlock*> Blocks,
+        const CFGBlockSet &Tails,
+        const CFGBlockSet &Blocks,
         const std::set<const VarDecl*> ControlVars,
         const std::set<const Stmt*> *TrackedStmts = NULL,
-        const std::set<const CFGBlock*> *TrackedBlocks = NULL,
+        const CFGBlockSet *TrackedBlocks = NULL,
         const NaturalLoop *Unsliced = NULL);
     void dump() const;
     void view(const LangOptions &LO = LangOptions()) const;
     void write(const LangOptions &LO = LangOptions()) const;
+    /* Estimated heap allocations of the loop graph. */
+    Allocations allocations() const;
 
     typedef std::list<NaturalLoopBlock*>::iterator                      iterator;
     typedef std::list<NaturalLoopBlock*>::const_iterator                const_iterator;
@@ -176,7 +291,7 @@ class NaturalLoop {
       }
     }
 
-    std::vector<PresumedLoc> getLoopStmtID(const SourceManager* SM) const {
+    std::vector<PresumedLoc> getLoopStmtID(const StmtLocations &Locations) const {
       std::vector<PresumedLoc> Result;
       std::stack<const CFGBlock*> Worklist;
       for (auto * Tail : Tails) {
@@ -206,8 +321,7 @@ class NaturalLoop {
           }
         }
         assert(S && "no statement");
-        const SourceLocation PL = S->getSourceRange().getBegin();
-        Result.push_back(SM->getPresumedLoc(PL));
+        Result.push_back(Locations[S]);
       }
 
       return Result;
@@ -363,6 +477,18 @@ NaturalLoop::~NaturalLoop() {
   }
 }
 
+Allocations NaturalLoop::allocations() const {
+  Allocations A = Tails.allocations();
+  A.addNodes<NaturalLoopBlock*>(Blocks.size());
+  A.addNodes<const VarDecl*>(ControlVars.size());
+  for (auto Block : Blocks) {
+    A.addBlock(sizeof(NaturalLoopBlock));
+    A.addNodes<const Stmt*>(Block->Stmts.size());
+    A.addNodes<NaturalLoopBlock*>(Block->Succs.size() + Block->Preds.size());
+  }
+  return A;
+}
+
 void NaturalLoop::dump() const {
   llvm::errs() << "Natural Loop\n";
   llvm::errs() << "============\n";
@@ -388,11 +514,11 @@ void NaturalLoop::dump() const {
 
 void NaturalLoop::build(
     const CFGBlock *Header,
-    const std::set<const CFGBlock*> Tails,
-    const std::set<const CFGBlock*> CFGBlocks,
+    const CFGBlockSet &Tails,
+    const CFGBlockSet &CFGBlocks,
     const std::set<const VarDecl*> ControlVars,
     const std::set<const Stmt*> *TrackedStmts, 
-    const std::set<const CFGBlock*> *TrackedBlocks,
+    const CFGBlockSet *TrackedBlocks,
     const NaturalLoop *Unsliced) {
 
 #undef DEBUG_TYPE
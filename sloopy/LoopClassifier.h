@@ -7,6 +7,8 @@
 
 #include "clang/AST/ASTContext.h"
 
+#include "Memory.h"
+
 using namespace clang;
 using namespace clang::tooling;
 
@@ -35,6 +37,10 @@ typedef std::map<std::string, ClassificationValue> ClassificationProperty;
 typedef std::map<const NaturalLoop * const, ClassificationProperty> ClassificationMap;
 ClassificationMap Classifications;
 std::map<const NaturalLoop*, std::string> LoopLocationMap;
+// Where the classifiers record results; -j worker threads point these at
+// per-function maps that are merged into the ones above afterwards.
+thread_local ClassificationMap *CurrentClassifications = &Classifications;
+thread_local std::map<const NaturalLoop*, std::string> *CurrentLoopLocations = &LoopLocationMap;
 
 enum class OutputFormat {
   JSON,
@@ -75,6 +81,18 @@ class ClassificationValueVisitor : public boost::static_visitor<std::string> {
     }
 };
 
+/* Estimated heap allocations of a loop's classification record. */
+Allocations classificationAllocations(const ClassificationProperty &Property) {
+  Allocations A;
+  A.addNodes<ClassificationProperty::value_type>(Property.size());
+  for (auto &Class : Property) {
+    if (const IncrementClassificationValue *ICV = boost::get<IncrementClassificationValue>(&Class.second)) {
+      A.addNodes<IncrementClassificationValue::value_type>(ICV->size());
+    }
+  }
+  return A;
+}
+
 void dumpClasses(llvm::raw_ostream &out, const ClassificationProperty Property, const OutputFormat OF = OutputFormat::Plain) {
   for (ClassificationProperty::const_iterator I = Property.begin(),
                                               E = Property.end();
@@ -119,17 +137,17 @@ void dumpClasses(llvm::raw_ostream &out, const OutputFormat OF = OutputFormat::J
 class LoopClassifier {
   public:
     static void classify(const NaturalLoop* Loop, const std::string Property) {
-      Classifications[Loop->getUnsliced()][Property] = 1;
+      (*CurrentClassifications)[Loop->getUnsliced()][Property] = 1;
     }
     template<typename T>
     static void classify(const NaturalLoop* Loop, const std::string Property, const T Value) {
-      Classifications[Loop->getUnsliced()][Property] = Value;
+      (*CurrentClassifications)[Loop->getUnsliced()][Property] = Value;
     }
     static void classify(const NaturalLoop* Loop, const std::string SubClass, const std::string Property, const std::string Value, const bool Success=true) {
       std::stringstream sstm;
       sstm << (Success ? "" : "!");
       sstm << Value;
-      auto &C = Classifications[Loop->getUnsliced()];
+      auto &C = (*CurrentClassifications)[Loop->getUnsliced()];
       if (C.find(SubClass) == C.end()) {
         C[SubClass] = IncrementClassificationValue();
       }
@@ -138,7 +156,7 @@ class LoopClassifier {
     }
     template<typename T>
     static void classify(const NaturalLoop* Loop, const std::string SubClass, const std::string Property, const T Value) {
-      auto &C = Classifications[Loop->getUnsliced()];
+      auto &C = (*CurrentClassifications)[Loop->getUnsliced()];
       if (C.find(SubClass) == C.end()) {
         C[SubClass] = IncrementClassificationValue();
       }
@@ -146,7 +164,7 @@ class LoopClassifier {
       ICV[Property] = Value;
     }
     static bool hasClass(const NaturalLoop* Loop, const std::string Property) {
-      auto C = Classifications[Loop->getUnsliced()][Property];
+      auto C = (*CurrentClassifications)[Loop->getUnsliced()][Property];
       int I = boost::get<int>(C);
       return I;
     }
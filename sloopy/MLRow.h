@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace sloopy {
+
+static double percentage(uint64_t Count, uint64_t N) {
+  if (N == 0) return 0;
+  return 100. * Count / N;
+}
+
+/*
+ * The aggregate -ml row of a benchmark, as raw counts.
+ * Shards of one benchmark print their rows with -ml-raw; sloopy-merge sums
+ * them and prints the percentage row a single run would have produced.
+ */
+struct MLRow {
+  std::string BenchName;
+  uint64_t Loops = 0;
+  uint64_t FinitePaths = 0;
+  uint64_t Proved = 0;
+  uint64_t AnyExitWeakCfWellformed = 0;
+  uint64_t TriviallyNonterminating = 0;
+  uint64_t Calls = 0, FPCalls = 0;
+  uint64_t Args = 0, FPArgs = 0;
+  uint64_t CFGBlocks = 0;   // of the last function analyzed
+  uint64_t MaxInDeg = 0;
+  uint64_t Time = 0, LoopTime = 0, CFGTime = 0, ParsingTime = 0;
+  // -memory-stats, 0 without
+  uint64_t PeakRSS = 0;             // KiB
+  uint64_t LoopAllocations = 0, LoopBytes = 0;
+  uint64_t ClassificationAllocations = 0, ClassificationBytes = 0;
+  uint64_t Z3Peak = 0;              // KiB, largest of any loop
+
+  static void printHeader(std::ostream &OS) {
+    OS << "benchmark\tbounded\tterminating\tsimple\ttnont\thard\tfpcalls\tfpargs\tcfgblocks\tmaxindeg\tsloopytime\tsloopylooptime\tsloopycfgtime\tsloopyparsing\tpeakrss\tloopallocs\tloopbytes\tclassallocs\tclassbytes\tz3peak\n";
+  }
+
+  static void printRawHeader(std::ostream &OS) {
+    OS << "benchmark\tloops\tbounded\tterminating\tsimple\ttnont\tcalls\tfpcalls\targs\tfpargs\tcfgblocks\tmaxindeg\tsloopytime\tsloopylooptime\tsloopycfgtime\tsloopyparsing\tpeakrss\tloopallocs\tloopbytes\tclassallocs\tclassbytes\tz3peak\n";
+  }
+
+  void print(std::ostream &OS) const {
+    OS <<
+      BenchName                                                                         << "\t" <<
+      percentage(FinitePaths, Loops)                                                    << "\t" <<
+      percentage(Proved, Loops)                                                         << "\t" <<
+      percentage(AnyExitWeakCfWellformed, Loops)                                        << "\t" <<
+      percentage(TriviallyNonterminating, Loops)                                        << "\t" <<
+      (Loops == 0 ? 0 : (100. - percentage(AnyExitWeakCfWellformed, Loops)))            << "\t" <<
+      percentage(FPCalls, Calls)                                                        << "\t" <<
+      percentage(FPArgs, Args)                                                          << "\t" <<
+      CFGBlocks                                                                         << "\t" <<
+      MaxInDeg                                                                          << "\t" <<
+      Time                                                                              << "\t" <<
+      LoopTime                                                                          << "\t" <<
+      CFGTime                                                                           << "\t" <<
+      ParsingTime                                                                       << "\t" <<
+      PeakRSS                                                                           << "\t" <<
+      LoopAllocations                                                                   << "\t" <<
+      LoopBytes                                                                         << "\t" <<
+      ClassificationAllocations                                                         << "\t" <<
+      ClassificationBytes                                                               << "\t" <<
+      Z3Peak                                                                            << "\n";
+  }
+
+  void printRaw(std::ostream &OS) const {
+    OS << BenchName << "\t" << Loops << "\t" << FinitePaths << "\t" << Proved
+       << "\t" << AnyExitWeakCfWellformed << "\t" << TriviallyNonterminating
+       << "\t" << Calls << "\t" << FPCalls << "\t" << Args << "\t" << FPArgs
+       << "\t" << CFGBlocks << "\t" << MaxInDeg << "\t" << Time << "\t"
+       << LoopTime << "\t" << CFGTime << "\t" << ParsingTime << "\t"
+       << PeakRSS << "\t" << LoopAllocations << "\t" << LoopBytes << "\t"
+       << ClassificationAllocations << "\t" << ClassificationBytes << "\t"
+       << Z3Peak << "\n";
+  }
+
+  /* Parses a row written by printRaw; returns false on a malformed row. */
+  bool parseRaw(const std::string &Line) {
+    std::istringstream IS(Line);
+    std::getline(IS, BenchName, '\t');
+    IS >> Loops >> FinitePaths >> Proved >> AnyExitWeakCfWellformed
+       >> TriviallyNonterminating >> Calls >> FPCalls >> Args >> FPArgs
+       >> CFGBlocks >> MaxInDeg >> Time >> LoopTime >> CFGTime >> ParsingTime
+       >> PeakRSS >> LoopAllocations >> LoopBytes >> ClassificationAllocations
+       >> ClassificationBytes >> Z3Peak;
+    return !IS.fail();
+  }
+
+  /* Adds the counts of a later shard. */
+  void merge(const MLRow &Other) {
+    if (BenchName.empty()) BenchName = Other.BenchName;
+    Loops += Other.Loops;
+    FinitePaths += Other.FinitePaths;
+    Proved += Other.Proved;
+    AnyExitWeakCfWellformed += Other.AnyExitWeakCfWellformed;
+    TriviallyNonterminating += Other.TriviallyNonterminating;
+    Calls += Other.Calls;
+    FPCalls += Other.FPCalls;
+    Args += Other.Args;
+    FPArgs += Other.FPArgs;
+    if (Other.CFGBlocks) CFGBlocks = Other.CFGBlocks;
+    MaxInDeg = std::max(MaxInDeg, Other.MaxInDeg);
+    Time += Other.Time;
+    LoopTime += Other.LoopTime;
+    CFGTime += Other.CFGTime;
+    ParsingTime += Other.ParsingTime;
+    // shards run in separate processes
+    PeakRSS = std::max(PeakRSS, Other.PeakRSS);
+    LoopAllocations += Other.LoopAllocations;
+    LoopBytes += Other.LoopBytes;
+    ClassificationAllocations += Other.ClassificationAllocations;
+    ClassificationBytes += Other.ClassificationBytes;
+    Z3Peak = std::max(Z3Peak, Other.Z3Peak);
+  }
+};
+
+} // end namespace sloopy
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "z3.h"
+
+/* Peak resident set size of the process in KiB. */
+long peakRSS() {
+  struct rusage Usage;
+  getrusage(RUSAGE_SELF, &Usage);
+  return Usage.ru_maxrss;
+}
+
+// Largest Z3_get_estimated_alloc_size() seen since the last reset on this
+// thread. Sampled before z3 contexts are destroyed, i.e. at their largest;
+// the estimate is process-wide, so under -j it includes other threads.
+thread_local uint64_t Z3PeakBytes = 0;
+
+void sampleZ3Memory() {
+  uint64_t Bytes = Z3_get_estimated_alloc_size();
+  if (Bytes > Z3PeakBytes) Z3PeakBytes = Bytes;
+}
+
+/*
+ * Estimated heap allocations of a data structure, counted from its sizes
+ * rather than by hooking the allocator.
+ */
+struct Allocations {
+  uint64_t Count = 0;
+  uint64_t Bytes = 0;
+
+  /*
+   * N elements of a node-based container (std::list, std::set, std::map):
+   * an allocation per element, holding it and a node header of up to 4
+   * pointers.
+   */
+  template<typename T>
+  void addNodes(uint64_t N) {
+    Count += N;
+    Bytes += N * (sizeof(T) + 4 * sizeof(void*));
+  }
+
+  /* A single allocation of Size bytes, e.g. the buffer of a vector. */
+  void addBlock(uint64_t Size) {
+    if (Size == 0) return;
+    Count++;
+    Bytes += Size;
+  }
+
+  Allocations &operator+=(const Allocations &Other) {
+    Count += Other.Count;
+    Bytes += Other.Bytes;
+    return *this;
+  }
+};
+
+/* Estimated memory use of one function's analysis, or of several. */
+struct FunctionMemory {
+  unsigned Loops = 0;
+  Allocations LoopAllocations;           // loop graphs and slicers
+  Allocations ClassificationAllocations; // class records
+  uint64_t Z3PeakBytes = 0;              // largest z3 estimate while classifying
+
+  void add(const FunctionMemory &Other) {
+    Loops += Other.Loops;
+    LoopAllocations += Other.LoopAllocations;
+    ClassificationAllocations += Other.ClassificationAllocations;
+    Z3PeakBytes = std::max(Z3PeakBytes, Other.Z3PeakBytes);
+  }
+};
+
+/*
+ * -memory-stats: a CSV row per analyzed function with its estimated memory
+ * use, and one per TU with the process' peak RSS after it; the TU whose row
+ * first shows a peak is the one that reached it.
+ */
+class MemoryStatsWriter {
+  llvm::raw_ostream &OS;
+
+  public:
+    MemoryStatsWriter(llvm::raw_ostream &OS) : OS(OS) {
+      OS << "kind,location,loops,loopallocs,loopbytes,classallocs,classbytes,z3peakkib,peakrsskib\n";
+    }
+
+    void writeFunction(const std::string &Location, const FunctionMemory &M) {
+      // locations contain no quotes, but may contain commas
+      OS << "function,\"" << Location << "\"," << M.Loops << ","
+         << M.LoopAllocations.Count << "," << M.LoopAllocations.Bytes << ","
+         << M.ClassificationAllocations.Count << "," << M.ClassificationAllocations.Bytes << ","
+         << M.Z3PeakBytes / 1024 << ",\n";
+    }
+
+    void writeTU(const std::string &File) {
+      OS << "tu,\"" << File << "\",,,,,,," << peakRSS() << "\n";
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Time.h"
+
+namespace sloopy {
+
+/*
+ * -progress: every -progress-interval seconds, reports TUs done/total,
+ * function and loop throughput, the slowest function so far and an ETA to
+ * stderr, or rewrites -progress-file with the line. Functions may be
+ * reported from -j worker threads.
+ *
+ * The TUs are those parsed from source: .ast inputs are only loaded, and a
+ * TU that fails to parse is dropped from the total, so the ETA extrapolates
+ * from analyzed TUs only.
+ */
+class ProgressReporter {
+  std::mutex Mutex;
+  unsigned TotalTUs;
+  const long Interval;   // ms
+  const std::string Filename;
+  const long Start;
+  long LastReport;
+  unsigned TUs = 0;
+  uint64_t Functions = 0, Loops = 0;
+  long SlowestTime = -1;
+  std::string Slowest;
+
+  static void printDuration(llvm::raw_ostream &OS, long Seconds) {
+    OS << llvm::format("%02ld:%02ld:%02ld", Seconds / 3600, Seconds / 60 % 60, Seconds % 60);
+  }
+
+  void print(llvm::raw_ostream &OS, long Now) {
+    double Elapsed = (Now - Start) / 1000.;
+    OS << "sloopy: " << TUs << "/" << TotalTUs << " TUs, "
+       << Functions << " functions (" << llvm::format("%.1f", Elapsed > 0 ? Functions / Elapsed : 0.) << "/s), "
+       << Loops << " loops (" << llvm::format("%.1f", Elapsed > 0 ? Loops / Elapsed : 0.) << "/s), elapsed ";
+    printDuration(OS, (Now - Start) / 1000);
+    if (SlowestTime >= 0) {
+      OS << ", slowest " << Slowest << " (" << SlowestTime << " ms)";
+    }
+    OS << ", ETA ";
+    if (TUs == 0 or TUs > TotalTUs) {
+      OS << "?";
+    } else {
+      printDuration(OS, (long)(Elapsed / TUs * (TotalTUs - TUs)));
+    }
+    OS << "\n";
+  }
+
+  // caller holds Mutex
+  void report(bool Force) {
+    long Now = now();
+    if (not Force and Now - LastReport < Interval) return;
+    LastReport = Now;
+    if (Filename.empty()) {
+      print(llvm::errs(), Now);
+      return;
+    }
+    // write a fresh file, then replace, so readers never see a partial line
+    std::string Temporary = Filename + ".tmp";
+    std::string ErrorInfo;
+    {
+      llvm::raw_fd_ostream OS(Temporary.c_str(), ErrorInfo);
+      if (!ErrorInfo.empty()) return;
+      print(OS, Now);
+    }
+    std::rename(Temporary.c_str(), Filename.c_str());
+  }
+
+  public:
+    ProgressReporter(unsigned TotalTUs, unsigned IntervalSeconds, const std::string &Filename) :
+      TotalTUs(TotalTUs), Interval(IntervalSeconds * 1000), Filename(Filename),
+      Start(now()), LastReport(Start) {}
+
+    /* Time is the analysis time in ms of the function at Location. */
+    void functionDone(const std::string &Location, long Time, unsigned FunctionLoops) {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      Functions++;
+      Loops += FunctionLoops;
+      if (Time > SlowestTime) {
+        SlowestTime = Time;
+        Slowest = Location;
+      }
+      report(false);
+    }
+
+    void TUDone() {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      TUs++;
+      report(false);
+    }
+
+    void TUFailed() {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (TotalTUs > 0) TotalTUs--;
+      report(false);
+    }
+
+    /* Reports regardless of the interval, e.g. at the end of the run. */
+    void finish() {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      report(true);
+    }
+};
+
+} // end namespace sloopy
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLParser.h"
+
+#include "CFGBuilder.h"
+
+namespace sloopy {
+
+/*
+ * Line-delimited JSON protocol of -server. A request is one line
+ *
+ *   {"id": 1, "file": "a.c", "args": ["-DX"], "func": "f", "line": 3,
+ *    "classes": ["Proved"]}
+ *
+ * of which only "file" is required; "args" are appended to the flags after
+ * `--`, "func"/"line" select loops as -func/-line do, "classes" restricts the
+ * reported classes. The answer is one line per loop
+ *
+ *   {"id": 1, "location": "a.c -func f -lines 3,", "classes": {...}}
+ *
+ * followed by {"id": 1, "loops": N}, or a single {"id": 1, "error": ...}.
+ * A numeric "id" is echoed as a number, any other as a string.
+ */
+struct ServerRequest {
+  std::string ID;
+  bool NumericID = false;
+  std::string File;
+  std::vector<std::string> Args;
+  std::string Function;
+  unsigned Line = 0;
+  std::set<std::string> Classes;
+};
+
+static void printJSONString(llvm::raw_ostream &OS, StringRef S) {
+  OS << '"';
+  for (char C : S) {
+    switch (C) {
+      case '"':  OS << "\\\""; break;
+      case '\\': OS << "\\\\"; break;
+      case '\n': OS << "\\n"; break;
+      case '\t': OS << "\\t"; break;
+      default:
+        if ((unsigned char)C < 0x20) {
+          OS << "\\u00";
+          OS.write_hex((unsigned char)C >> 4);
+          OS.write_hex(C & 0xf);
+        } else {
+          OS << C;
+        }
+    }
+  }
+  OS << '"';
+}
+
+static void printID(llvm::raw_ostream &OS, const ServerRequest &Req) {
+  if (Req.NumericID) OS << Req.ID;
+  else printJSONString(OS, Req.ID);
+}
+
+// ClassificationValueVisitor's JSON spans lines; responses must not
+class CompactJSONVisitor : public boost::static_visitor<void> {
+  llvm::raw_ostream &OS;
+  public:
+    CompactJSONVisitor(llvm::raw_ostream &OS) : OS(OS) {}
+    void operator()(int I) const { OS << I; }
+    void operator()(unsigned I) const { OS << I; }
+    void operator()(const std::string &S) const { printJSONString(OS, S); }
+    void operator()(const IncrementClassificationValue &V) const {
+      OS << "{";
+      for (auto I = V.begin(), E = V.end(); I != E; I++) {
+        if (I != V.begin()) OS << ", ";
+        printJSONString(OS, I->first);
+        OS << ": ";
+        boost::apply_visitor(*this, I->second);
+      }
+      OS << "}";
+    }
+};
+
+class SloopyServer {
+  MatchFinder &Finder;
+  FunctionCallback &FC;
+  const std::vector<std::string> DefaultArgs;
+  const std::string ResourcesPath;
+  const unsigned CacheSize;
+
+  // parsed TUs by file and flags, most recently used first; reparsing a
+  // cached TU picks up changes and reuses its precompiled preamble
+  typedef std::pair<std::string, std::vector<std::string>> ASTKey;
+  std::list<std::pair<ASTKey, std::unique_ptr<ASTUnit>>> ASTs;
+
+  static bool getScalar(llvm::yaml::Node *N, std::string &Value) {
+    llvm::yaml::ScalarNode *S = dyn_cast_or_null<llvm::yaml::ScalarNode>(N);
+    if (!S) return false;
+    SmallString<64> Storage;
+    Value = S->getValue(Storage).str();
+    return true;
+  }
+
+  static bool getList(llvm::yaml::Node *N, std::vector<std::string> &Values) {
+    llvm::yaml::SequenceNode *S = dyn_cast_or_null<llvm::yaml::SequenceNode>(N);
+    if (!S) return false;
+    for (auto &Item : *S) {
+      std::string Value;
+      if (!getScalar(&Item, Value)) return false;
+      Values.push_back(Value);
+    }
+    return true;
+  }
+
+  static bool parseRequest(StringRef Line, ServerRequest &Req, std::string &Error) {
+    llvm::SourceMgr SM;
+    // diagnostics go to the response, not to stderr
+    SM.setDiagHandler([](const llvm::SMDiagnostic &, void *) {}, NULL);
+    llvm::yaml::Stream Stream(Line, SM);
+    llvm::yaml::document_iterator D = Stream.begin();
+    llvm::yaml::MappingNode *Root = D == Stream.end() ? NULL : dyn_cast_or_null<llvm::yaml::MappingNode>(D->getRoot());
+    if (!Root) {
+      Error = "request is not a JSON object";
+      return false;
+    }
+    for (auto &KV : *Root) {
+      std::string Key;
+      if (!getScalar(KV.getKey(), Key)) {
+        Error = "malformed key";
+        return false;
+      }
+      bool Ok = true;
+      if (Key == "id") {
+        Ok = getScalar(KV.getValue(), Req.ID);
+        // a plain (unquoted) scalar of number characters
+        llvm::yaml::ScalarNode *S = dyn_cast_or_null<llvm::yaml::ScalarNode>(KV.getValue());
+        Req.NumericID = Ok and not Req.ID.empty() and
+                        S->getRawValue().find_first_of("\"'") == StringRef::npos and
+                        Req.ID.find_first_not_of("-+.0123456789eE") == std::string::npos;
+      } else if (Key == "file") {
+        Ok = getScalar(KV.getValue(), Req.File);
+      } else if (Key == "args") {
+        Ok = getList(KV.getValue(), Req.Args);
+      } else if (Key == "func") {
+        Ok = getScalar(KV.getValue(), Req.Function);
+      } else if (Key == "line") {
+        std::string Value;
+        Ok = getScalar(KV.getValue(), Value) and not StringRef(Value).getAsInteger(10, Req.Line);
+      } else if (Key == "classes") {
+        std::vector<std::string> Classes;
+        Ok = getList(KV.getValue(), Classes);
+        Req.Classes.insert(Classes.begin(), Classes.end());
+      } else {
+        KV.skip();
+      }
+      if (!Ok) {
+        Error = "malformed value of \"" + Key + "\"";
+        return false;
+      }
+    }
+    if (Stream.failed()) {
+      Error = "request is not valid JSON";
+      return false;
+    }
+    if (Req.File.empty()) {
+      Error = "request has no \"file\"";
+      return false;
+    }
+    return true;
+  }
+
+  ASTUnit *getAST(const ServerRequest &Req, std::string &Error) {
+    std::vector<std::string> Args(DefaultArgs);
+    Args.insert(Args.end(), Req.Args.begin(), Req.Args.end());
+    ASTKey Key(Req.File, Args);
+
+    for (auto I = ASTs.begin(), E = ASTs.end(); I != E; I++) {
+      if (I->first == Key) {
+        ASTs.splice(ASTs.begin(), ASTs, I);
+        ASTUnit *AST = ASTs.front().second.get();
+        if (AST->Reparse()) {
+          Error = "cannot reparse " + Req.File;
+          ASTs.pop_front();
+          return NULL;
+        }
+        return AST;
+      }
+    }
+
+    // LoadFromCommandLine adds the program name and -fsyntax-only itself
+    std::vector<const char*> Argv;
+    for (auto &Arg : Args) {
+      Argv.push_back(Arg.c_str());
+    }
+    Argv.push_back(Req.File.c_str());
+    IntrusiveRefCntPtr<DiagnosticsEngine> Diags =
+      CompilerInstance::createDiagnostics(new DiagnosticOptions());
+    ASTUnit *AST = ASTUnit::LoadFromCommandLine(
+        Argv.data(), Argv.data() + Argv.size(), Diags, ResourcesPath,
+        /*OnlyLocalDecls=*/false, /*CaptureDiagnostics=*/true,
+        llvm::None, /*RemappedFilesKeepOriginalName=*/true,
+        /*PrecompilePreamble=*/true);
+    if (!AST) {
+      Error = "cannot parse " + Req.File;
+      return NULL;
+    }
+
+    ASTs.push_front(std::make_pair(Key, std::unique_ptr<ASTUnit>(AST)));
+    while (ASTs.size() > CacheSize) {
+      ASTs.pop_back();
+    }
+    return AST;
+  }
+
+  static bool onLine(const std::string &Location, unsigned Line) {
+    size_t Lines = Location.rfind(" -lines ");
+    if (Lines == std::string::npos) return false;
+    SmallVector<StringRef, 4> Numbers;
+    StringRef(Location).substr(Lines + 8).split(Numbers, ",", -1, false);
+    for (auto N : Numbers) {
+      unsigned L;
+      if (!N.getAsInteger(10, L) and L == Line) return true;
+    }
+    return false;
+  }
+
+  void handle(StringRef Line, llvm::raw_ostream &Out) {
+    ServerRequest Req;
+    std::string Error;
+    ASTUnit *AST = NULL;
+    if (parseRequest(Line, Req, Error)) {
+      AST = getAST(Req, Error);
+    }
+    if (!AST) {
+      Out << "{\"id\": ";
+      printID(Out, Req);
+      Out << ", \"error\": ";
+      printJSONString(Out, Error);
+      Out << "}\n";
+      Out.flush();
+      return;
+    }
+
+    Function = Req.Function;
+    SloopyConsumer Consumer(Finder, FC);
+    Consumer.HandleTranslationUnit(AST->getASTContext());
+
+    // report in source order
+    std::vector<std::pair<std::string, const ClassificationProperty*>> Loops;
+    for (auto &Pair : Classifications) {
+      const std::string &Location = LoopLocationMap[Pair.first];
+      if (Req.Line and not onLine(Location, Req.Line)) continue;
+      Loops.push_back(std::make_pair(Location, &Pair.second));
+    }
+    std::sort(Loops.begin(), Loops.end());
+
+    for (auto &Loop : Loops) {
+      Out << "{\"id\": ";
+      printID(Out, Req);
+      Out << ", \"location\": ";
+      printJSONString(Out, Loop.first);
+      Out << ", \"classes\": {";
+      bool First = true;
+      for (auto &Class : *Loop.second) {
+        if (Req.Classes.size() and not Req.Classes.count(Class.first)) continue;
+        if (not First) Out << ", ";
+        First = false;
+        printJSONString(Out, Class.first);
+        Out << ": ";
+        boost::apply_visitor(CompactJSONVisitor(Out), Class.second);
+      }
+      Out << "}}\n";
+    }
+    Out << "{\"id\": ";
+    printID(Out, Req);
+    Out << ", \"loops\": " << Loops.size() << "}\n";
+    Out.flush();
+
+    // the loops are only referenced from the maps
+    for (auto &Pair : Classifications) {
+      delete Pair.first;
+    }
+    Classifications.clear();
+    LoopLocationMap.clear();
+  }
+
+  public:
+    SloopyServer(MatchFinder &Finder, FunctionCallback &FC,
+                 const std::vector<std::string> &DefaultArgs,
+                 const std::string &ResourcesPath, unsigned CacheSize) :
+      Finder(Finder), FC(FC), DefaultArgs(DefaultArgs),
+      ResourcesPath(ResourcesPath), CacheSize(CacheSize) {}
+
+    /* Answers requests from In until EOF. */
+    void serve(FILE *In, llvm::raw_ostream &Out) {
+      char *Buffer = NULL;
+      size_t Size = 0;
+      ssize_t Length;
+      while ((Length = getline(&Buffer, &Size, In)) != -1) {
+        StringRef Line = StringRef(Buffer, Length).trim();
+        if (Line.empty()) continue;
+        handle(Line, Out);
+      }
+      free(Buffer);
+    }
+
+    /* Serves one client at a time on a unix domain socket at Path. */
+    bool serveSocket(const std::string &Path) {
+      struct sockaddr_un Addr;
+      if (Path.size() >= sizeof(Addr.sun_path)) {
+        llvm::errs() << "error: socket path too long: " << Path << "\n";
+        return false;
+      }
+      int Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (Socket < 0) {
+        llvm::errs() << "error: cannot create socket\n";
+        return false;
+      }
+      memset(&Addr, 0, sizeof(Addr));
+      Addr.sun_family = AF_UNIX;
+      strncpy(Addr.sun_path, Path.c_str(), sizeof(Addr.sun_path) - 1);
+      unlink(Path.c_str());
+      if (bind(Socket, (struct sockaddr *)&Addr, sizeof(Addr)) < 0 or
+          listen(Socket, 8) < 0) {
+        llvm::errs() << "error: cannot listen on " << Path << "\n";
+        close(Socket);
+        return false;
+      }
+      for (;;) {
+        int Connection = accept(Socket, NULL, NULL);
+        if (Connection < 0) {
+          if (errno == EINTR or errno == ECONNABORTED) continue;
+          llvm::errs() << "error: cannot accept on " << Path << ": " << strerror(errno) << "\n";
+          close(Socket);
+          return false;
+        }
+        FILE *In = fdopen(dup(Connection), "r");
+        llvm::raw_fd_ostream Out(Connection, /*shouldClose=*/true);
+        if (In) {
+          serve(In, Out);
+          fclose(In);
+        }
+      }
+    }
+};
+
+} // end namespace sloopy
@@ -7,6 +7,7 @@
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInvocation.h"
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Rewrite/Core/Rewriter.h"
@@ -24,6 +25,9 @@
 
 #include "CmdLine.h"
 #include "CFGBuilder.h"
+#include "Memory.h"
+#include "MLRow.h"
+#include "Server.h"
 #include "Time.h"
 
 using namespace clang;
@@ -33,41 +37,156 @@ using namespace llvm;
 
 using namespace sloopy;
 
-double percentage(unsigned Count, unsigned N) {
-  if (N == 0) return 0;
-  return 100. * Count / N;
+/*
+ * -shard=i/n selects the i-th of n contiguous chunks of the source list, so
+ * that the last shard ends with the file a single run would analyze last.
+ */
+static bool selectShard(const std::vector<std::string> &Sources,
+                        std::vector<std::string> &Selected) {
+  if (Shard.empty()) {
+    Selected = Sources;
+    return true;
+  }
+  unsigned Index, Count;
+  char Slash;
+  std::istringstream IS(Shard);
+  if (!(IS >> Index >> Slash >> Count) || Slash != '/' || !IS.eof() ||
+      Count == 0 || Index >= Count) {
+    llvm::errs() << "invalid -shard=" << Shard << ", expected i/n with i < n\n";
+    return false;
+  }
+  size_t Begin = Sources.size() * Index / Count;
+  size_t End = Sources.size() * (Index + 1) / Count;
+  Selected.assign(Sources.begin() + Begin, Sources.begin() + End);
+  return true;
+}
+
+/*
+ * -server takes its sources from the requests, so the command line has none
+ * for CommonOptionsParser. Flags after `--` are the default flags of every
+ * request.
+ */
+static int runServer(int argc, const char **argv) {
+  std::vector<std::string> DefaultArgs;
+  for (int I = 1; I < argc; I++) {
+    if (StringRef(argv[I]) == "--") {
+      DefaultArgs.assign(argv + I + 1, argv + argc);
+      argc = I;
+      break;
+    }
+  }
+  cl::ParseCommandLineOptions(argc, argv);
+
+  MatchFinder Finder;
+  FunctionCallback FC;
+  Finder.addMatcher(FunctionMatcher, &FC);
+
+  std::string ResourcesPath =
+    CompilerInvocation::GetResourcesPath(argv[0], (void*)(intptr_t) runServer);
+  SloopyServer S(Finder, FC, DefaultArgs, ResourcesPath, ServerCache);
+  if (ServerSocket != "") {
+    return S.serveSocket(ServerSocket) ? 0 : 1;
+  }
+  S.serve(stdin, llvm::outs());
+  return 0;
 }
 
 int main(int argc, const char **argv) {
   llvm::sys::PrintStackTraceOnErrorSignal();
 
+  for (int I = 1; I < argc and StringRef(argv[I]) != "--"; I++) {
+    StringRef Arg(argv[I]);
+    if (Arg == "-server" or Arg.startswith("-server-socket")) {
+      return runServer(argc, argv);
+    }
+  }
+
   // parse options
   CommonOptionsParser OptionsParser(argc, argv);
 
 
   if (MachineLearningFormat) {
-    std::cout << "benchmark\tbounded\tterminating\tsimple\ttnont\thard\tfpcalls\tfpargs\tcfgblocks\tmaxindeg\tsloopytime\tsloopylooptime\tsloopycfgtime\tsloopyparsing\n";
+    if (MachineLearningRaw) {
+      MLRow::printRawHeader(std::cout);
+    } else {
+      MLRow::printHeader(std::cout);
+    }
     return 0;
   }
 
+  std::vector<std::string> Sources;
+  if (!selectShard(OptionsParser.getSourcePathList(), Sources)) {
+    return 1;
+  }
+
+  // serialized ASTs are loaded directly, everything else is parsed
+  std::vector<std::string> ASTFiles, SourceFiles;
+  for (auto &Source : Sources) {
+    if (StringRef(Source).endswith(".ast")) {
+      ASTFiles.push_back(Source);
+    } else {
+      SourceFiles.push_back(Source);
+    }
+  }
+
   // setup clang tool
-  ClangTool Tool(OptionsParser.getCompilations(),
-                 OptionsParser.getSourcePathList());
+  ClangTool Tool(OptionsParser.getCompilations(), SourceFiles);
   MatchFinder Finder;
 
-  FunctionCallback FC;
-  CFGCallback CFGFC;
-  Finder.addMatcher(FunctionMatcher, &FC);
-  Finder.addMatcher(FunctionMatcher, &CFGFC);
+  // per-loop features
+  std::unique_ptr<raw_fd_ostream> FeaturesCSVStream, FeaturesBinaryStream;
+  std::string ErrorInfo;
+  if (!FeaturesCSV.empty()) {
+    FeaturesCSVStream.reset(new raw_fd_ostream(FeaturesCSV.c_str(), ErrorInfo));
+  }
+  if (ErrorInfo.empty() && !FeaturesBinary.empty()) {
+    FeaturesBinaryStream.reset(new raw_fd_ostream(FeaturesBinary.c_str(), ErrorInfo, sys::fs::F_Binary));
+  }
+  if (!ErrorInfo.empty()) {
+    llvm::errs() << ErrorInfo << "\n";
+    return 1;
+  }
+  std::unique_ptr<LoopFeatureWriter> FeatureWriter;
+  if (FeaturesCSVStream || FeaturesBinaryStream) {
+    FeatureWriter.reset(new LoopFeatureWriter(FeaturesCSVStream.get(), FeaturesBinaryStream.get()));
+  }
 
-  auto CallMatcher = callExpr().bind(FunctionName);
-  FPCallback FPC;
-  Finder.addMatcher(CallMatcher, &FPC);
+  std::unique_ptr<ProgressReporter> Reporter;
+  if (Progress or ProgressFile != "") {
+    // ClangTool skips sources without compile command
+    unsigned ParsedTUs = 0;
+    for (auto &Source : SourceFiles) {
+      if (!OptionsParser.getCompilations().getCompileCommands(getAbsolutePath(Source)).empty()) {
+        ParsedTUs++;
+      }
+    }
+    Reporter.reset(new ProgressReporter(ParsedTUs, ProgressInterval, ProgressFile));
+  }
+
+  // per-function and per-TU memory use
+  std::unique_ptr<raw_fd_ostream> MemoryStatsStream;
+  std::unique_ptr<MemoryStatsWriter> MemoryWriter;
+  if (!MemoryStats.empty()) {
+    MemoryStatsStream.reset(new raw_fd_ostream(MemoryStats.c_str(), ErrorInfo));
+    if (!ErrorInfo.empty()) {
+      llvm::errs() << ErrorInfo << "\n";
+      return 1;
+    }
+    MemoryWriter.reset(new MemoryStatsWriter(*MemoryStatsStream));
+  }
+
+  FunctionCallback FC(FeatureWriter.get(), Reporter.get(), MemoryWriter.get());
+  Finder.addMatcher(FunctionMatcher, &FC);
 
   // run
   long Begin = now();
-  unsigned ret = Tool.run(newFrontendActionFactory(&Finder));
+  SloopyConsumerFactory ConsumerFactory(Finder, FC);
+  unsigned ret = SourceFiles.empty() ? 0 : Tool.run(newFrontendActionFactory(&ConsumerFactory));
+  for (auto &ASTFile : ASTFiles) {
+    if (!analyzeASTFile(ASTFile, Finder, FC)) ret = 1;
+  }
   /* we continue even if sloopy failed on some file */
+  if (Reporter) Reporter->finish();
 
   // print statistics
   if (LoopStats) {
@@ -86,44 +205,47 @@ int main(int argc, const char **argv) {
     ostream.close();
   }
 
-  if (MachineLearning) {
-    size_t NumLoops = Classifications.size();
-    std::map<std::string,unsigned> ClassCounts = {
-      { "FinitePaths", 0 },
-      { "Proved", 0 },
-      { "AnyExitWeakCfWellformed", 0 },
-      { "TriviallyNonterminating", 0 },
-      { "ANY", 0 },
-      { "Time", 0 }
-    };
+  if (MachineLearning or MachineLearningRaw) {
+    MLRow Row;
+    Row.BenchName = BenchName;
+    Row.Loops = Classifications.size();
     for (ClassificationMap::const_iterator I = Classifications.begin(),
                                            E = Classifications.end();
                                            I != E; I++) {
       auto PropertyMap = I->second;
-      for (std::map<std::string,unsigned>::iterator it=ClassCounts.begin(); it!=ClassCounts.end(); ++it) {
-        std::string CurrentProperty = it->first;
-        if(int CurrentValue = boost::get<int>(PropertyMap[CurrentProperty])) {
-          ClassCounts[CurrentProperty] += CurrentValue;
-        }
-      }
+      auto count = [&PropertyMap](const std::string &Property) -> unsigned {
+        return boost::get<int>(PropertyMap[Property]);
+      };
+      Row.FinitePaths += count("FinitePaths");
+      Row.Proved += count("Proved");
+      Row.AnyExitWeakCfWellformed += count("AnyExitWeakCfWellformed");
+      Row.TriviallyNonterminating += count("TriviallyNonterminating");
     }
+    Row.Calls = FC.FPStats.calls;
+    Row.FPCalls = FC.FPStats.fp_calls;
+    Row.Args = FC.FPStats.args;
+    Row.FPArgs = FC.FPStats.fp_args;
+    Row.CFGBlocks = FC.CFGStats.size;
+    Row.MaxInDeg = FC.CFGStats.max_fan_in;
 
     long End = now();
-    std::cout <<
-      BenchName                                                                                   << "\t" <<
-      percentage(ClassCounts["FinitePaths"], NumLoops)                                            << "\t" <<
-      percentage(ClassCounts["Proved"], NumLoops)                                                 << "\t" <<
-      percentage(ClassCounts["AnyExitWeakCfWellformed"], NumLoops)                                << "\t" <<
-      percentage(ClassCounts["TriviallyNonterminating"], NumLoops)                                << "\t" <<
-      (NumLoops == 0 ? 0 : (100. - percentage(ClassCounts["AnyExitWeakCfWellformed"], NumLoops))) << "\t" <<
-      percentage(FPC.fp_calls, FPC.calls)                                                         << "\t" <<
-      percentage(FPC.fp_args, FPC.args)                                                           << "\t" <<
-      CFGFC.size                                                                                  << "\t" <<
-      CFGFC.max_fan_in                                                                            << "\t" <<
-      (End-Begin)                                                                                 << "\t" <<
-      FC.time                                                                                     << "\t" <<
-      (FPC.time + CFGFC.time)                                                                     << "\t" <<
-      (End-Begin-FC.time-FPC.time-CFGFC.time)                                                     << "\n";
+    Row.Time = End-Begin;
+    Row.LoopTime = FC.time;
+    Row.CFGTime = FC.stats_time;
+    Row.ParsingTime = End-Begin-FC.time-FC.stats_time;
+    if (MemoryWriter) {
+      Row.PeakRSS = peakRSS();
+      Row.LoopAllocations = FC.TotalMemory.LoopAllocations.Count;
+      Row.LoopBytes = FC.TotalMemory.LoopAllocations.Bytes;
+      Row.ClassificationAllocations = FC.TotalMemory.ClassificationAllocations.Count;
+      Row.ClassificationBytes = FC.TotalMemory.ClassificationAllocations.Bytes;
+      Row.Z3Peak = FC.TotalMemory.Z3PeakBytes / 1024;
+    }
+    if (MachineLearningRaw) {
+      Row.printRaw(std::cout);
+    } else {
+      Row.print(std::cout);
+    }
   }
 
   return ret;
@@ -0,0 +1,118 @@
+#include "fstream"
+#include "iostream"
+#include "sstream"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "MLRow.h"
+
+using namespace llvm;
+
+using namespace sloopy;
+
+/*
+ * Combines the outputs of sloopy runs over shards of one benchmark
+ * (-shard=0/n ... -shard=n-1/n) into the outputs of a single run:
+ *  - the <bench-name>.json files of -loop-stats are concatenated into -o,
+ *  - the -ml-raw rows are summed and printed as the -ml row.
+ * Inputs are expected in shard order.
+ */
+
+cl::list<std::string> Inputs(cl::Positional, cl::OneOrMore,
+                             cl::desc("<shard.json or -ml-raw output>..."));
+cl::opt<std::string> BenchName("bench-name",
+                               cl::desc("Benchmark name of the merged row"));
+cl::opt<std::string> Output("o", cl::desc("Merged JSON file"),
+                            cl::value_desc("filename"));
+
+static bool readFile(const std::string &Filename, std::string &Content) {
+  std::ifstream IS(Filename.c_str());
+  if (!IS) {
+    errs() << "sloopy-merge: cannot read " << Filename << "\n";
+    return false;
+  }
+  std::stringstream sstm;
+  sstm << IS.rdbuf();
+  Content = sstm.str();
+  return true;
+}
+
+/* The loop objects of a dumpClasses JSON file, i.e. the text inside [ ]. */
+static bool getJSONElements(const std::string &Filename, std::string &Elements) {
+  std::string Content;
+  if (!readFile(Filename, Content)) return false;
+  StringRef Text = StringRef(Content).trim();
+  if (!Text.startswith("[") or !Text.endswith("]")) {
+    errs() << "sloopy-merge: " << Filename << " is not a sloopy JSON file\n";
+    return false;
+  }
+  Elements = Text.drop_front().drop_back().trim().str();
+  if (!Elements.empty()) Elements += "\n";
+  return true;
+}
+
+int main(int argc, const char **argv) {
+  llvm::sys::PrintStackTraceOnErrorSignal();
+  cl::ParseCommandLineOptions(argc, argv, "sloopy shard merger\n");
+
+  bool HasJSON = false, HasRows = false;
+  std::string JSON;
+  MLRow Merged;
+  for (auto Input : Inputs) {
+    if (StringRef(Input).endswith(".json")) {
+      std::string Elements;
+      if (!getJSONElements(Input, Elements)) return 1;
+      if (!JSON.empty() and !Elements.empty()) JSON += ",\n";
+      JSON += Elements;
+      HasJSON = true;
+      continue;
+    }
+
+    std::ifstream IS(Input.c_str());
+    if (!IS) {
+      errs() << "sloopy-merge: cannot read " << Input << "\n";
+      return 1;
+    }
+    std::string Line;
+    while (std::getline(IS, Line)) {
+      // skip empty lines and -ml-format -ml-raw headers
+      if (Line.empty() or StringRef(Line).startswith("benchmark\t")) continue;
+      MLRow Row;
+      if (!Row.parseRaw(Line)) {
+        errs() << "sloopy-merge: malformed row in " << Input << ": " << Line << "\n";
+        return 1;
+      }
+      Merged.merge(Row);
+      HasRows = true;
+    }
+  }
+
+  if (HasJSON) {
+    std::string Filename = Output;
+    if (Filename.empty()) {
+      if (BenchName.empty()) {
+        errs() << "sloopy-merge: merging JSON files needs -o or -bench-name\n";
+        return 1;
+      }
+      Filename = BenchName + ".json";
+    }
+    std::string ErrorInfo;
+    raw_fd_ostream ostream(Filename.c_str(), ErrorInfo);
+    if (!ErrorInfo.empty()) {
+      errs() << "sloopy-merge: " << ErrorInfo << "\n";
+      return 1;
+    }
+    ostream << "[\n" << JSON << "]\n";
+    ostream.close();
+  }
+
+  if (HasRows) {
+    if (!BenchName.empty()) Merged.BenchName = BenchName;
+    Merged.print(std::cout);
+  }
+
+  return 0;
+}
@@ -1,9 +1,12 @@
 // RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
 // RUN: grep -Ev "// *[A-Z-]+:" %s > %t_risky.cpp
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t_single.cpp
 // RUN: clang-modernize -loop-convert -use-nullptr %t.cpp -- -std=c++11
 // RUN: FileCheck -input-file=%t.cpp %s
 // RUN: clang-modernize -loop-convert -use-nullptr -risk=risky %t_risky.cpp -- -std=c++11
 // RUN: FileCheck -check-prefix=RISKY -input-file=%t_risky.cpp %s
+// RUN: clang-modernize -loop-convert -use-nullptr -single-parse %t_single.cpp -- -std=c++11
+// RUN: FileCheck -input-file=%t_single.cpp %s
 
 #define NULL 0
 
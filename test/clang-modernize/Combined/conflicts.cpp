@@ -0,0 +1,33 @@
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: clang-modernize -loop-convert -use-auto -single-parse -summary %t.cpp -- -std=c++11 -I %S/../UseAuto/Inputs | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -input-file=%t.cpp %s
+//
+// Running the transforms one after the other gives the same result.
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.separate.cpp
+// RUN: clang-modernize -loop-convert -use-auto %t.separate.cpp -- -std=c++11 -I %S/../UseAuto/Inputs
+// RUN: diff %t.cpp %t.separate.cpp
+
+#define CONTAINER vector
+#include "test_std_container.h"
+#undef CONTAINER
+
+// Both transforms rewrite the header of the loop. LoopConvert comes first and
+// wins; all UseAuto changes of the translation unit are deferred to a second
+// pass over the converted file, which only has J left to change.
+// SUMMARY: Transform: LoopConvert - Accepted: 1
+// SUMMARY: Transform: UseAuto - Accepted: 1 - Rejected: 0 - Deferred: 2
+
+int f() {
+  std::vector<int> Vec;
+  int Sum = 0;
+
+  for (std::vector<int>::iterator I = Vec.begin(); I != Vec.end(); ++I) {
+    Sum += *I;
+  }
+  // CHECK: for (auto && elem : Vec) {
+  // CHECK-NEXT: Sum += elem;
+
+  std::vector<int>::iterator J = Vec.begin();
+  // CHECK: auto J = Vec.begin();
+  return Sum;
+}
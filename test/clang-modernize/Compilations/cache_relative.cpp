@@ -0,0 +1,26 @@
+// Test that a relative -cache-dir is resolved against the current directory,
+// not against the directory of the compile command of each source.
+
+// RUN: rm -rf %T/CacheRelative
+// RUN: mkdir -p %T/CacheRelative/a1/include
+// RUN: sed -e 's#$(path)#%/T/CacheRelative#g' %S/Inputs/parallel_dirs.json > %T/CacheRelative/compile_commands.json
+// RUN: echo '#define NULL_A 0' > %T/CacheRelative/a1/include/a.h
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %T/CacheRelative/a1/a.cpp
+// RUN: cd %T/CacheRelative && clang-modernize -use-nullptr -summary -cache-dir=cache -p=%T/CacheRelative %T/CacheRelative/a1/a.cpp | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -input-file=%T/CacheRelative/a1/a.cpp %s
+// RUN: ls %T/CacheRelative/cache | count 1
+// RUN: not ls %T/CacheRelative/a1/cache
+//
+// Restore the original source: the second run reuses the cached changes.
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %T/CacheRelative/a1/a.cpp
+// RUN: cd %T/CacheRelative && clang-modernize -use-nullptr -summary -cache-dir=cache -p=%T/CacheRelative %T/CacheRelative/a1/a.cpp 2>&1 | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -input-file=%T/CacheRelative/a1/a.cpp %s
+// RUN: ls %T/CacheRelative/cache | count 1
+
+// SUMMARY-NOT: Error opening cache entry
+// SUMMARY: Transform: UseNullptr - Accepted: 1
+
+#include "a.h"
+
+int *P = 0;
+// CHECK: int *P = nullptr;
@@ -0,0 +1,23 @@
+// Test that -j transforms one source at a time when the compile commands of
+// the sources run in different directories, so that the relative include
+// paths of each source are resolved against its own directory.
+
+// RUN: rm -rf %T/ParallelDirs
+// RUN: mkdir -p %T/ParallelDirs/a1/include
+// RUN: mkdir -p %T/ParallelDirs/a2/include
+// RUN: sed -e 's#$(path)#%/T/ParallelDirs#g' %S/Inputs/parallel_dirs.json > %T/ParallelDirs/compile_commands.json
+// RUN: echo '#define NULL_A 0' > %T/ParallelDirs/a1/include/a.h
+// RUN: echo '#define NULL_B 0' > %T/ParallelDirs/a2/include/b.h
+// RUN: grep -Ev "// *[A-Z-]+:" %s | sed -e 's#HEADER#"a.h"#' > %T/ParallelDirs/a1/a.cpp
+// RUN: grep -Ev "// *[A-Z-]+:" %s | sed -e 's#HEADER#"b.h"#' > %T/ParallelDirs/a2/b.cpp
+
+// RUN: clang-modernize -use-nullptr -j 2 -p=%T/ParallelDirs %T/ParallelDirs/a1/a.cpp %T/ParallelDirs/a2/b.cpp 2>&1 | FileCheck -check-prefix=NOTE %s
+// RUN: FileCheck -input-file=%T/ParallelDirs/a1/a.cpp %s
+// RUN: FileCheck -input-file=%T/ParallelDirs/a2/b.cpp %s
+
+// NOTE: note: -j: the compile commands of the sources run in different directories, transforming one source at a time
+
+#include HEADER
+
+int *P = 0;
+// CHECK: int *P = nullptr;
@@ -0,0 +1,22 @@
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: rm -rf %t.cache
+// RUN: clang-modernize -use-nullptr -summary -cache-dir=%t.cache %t.cpp -- -std=c++11 | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -input-file=%t.cpp %s
+//
+// Restore the original source: the second run must reuse the cached changes
+// and report the same summary.
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: clang-modernize -use-nullptr -summary -cache-dir=%t.cache %t.cpp -- -std=c++11 | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -input-file=%t.cpp %s
+// RUN: ls %t.cache | count 1
+
+#define NULL 0
+
+void f() {
+  int *p = 0;
+  // CHECK: int *p = nullptr;
+  char *q = NULL;
+  // CHECK: char *q = nullptr;
+}
+
+// SUMMARY: Transform: UseNullptr - Accepted: 2
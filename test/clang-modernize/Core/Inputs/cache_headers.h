@@ -0,0 +1,6 @@
+#define NULL 0
+
+inline void h() {
+  int *p = 0;
+  // CHECK: int *p = nullptr;
+}
@@ -0,0 +1,5 @@
+#include "cache_headers.h"
+
+void b() {
+  char *q = NULL;
+}
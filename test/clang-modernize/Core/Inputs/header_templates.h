@@ -0,0 +1,2 @@
+template <class T> T *make() { return 0; }
+// CHECK: template <class T> T *make() { return nullptr; }
@@ -0,0 +1,3 @@
+#include "header_templates.h"
+
+int *b() { return make<int>(); }
@@ -0,0 +1,14 @@
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: cp %t.cpp %t.orig.cpp
+//
+// nullptr is not a keyword in C++98: the check fails and nothing is written.
+// RUN: not clang-modernize -final-syntax-check -use-nullptr %t.cpp -- -std=c++98
+// RUN: diff %t.orig.cpp %t.cpp
+//
+// RUN: clang-modernize -final-syntax-check -use-nullptr -j=2 %t.cpp -- -std=c++11
+// RUN: FileCheck -input-file=%t.cpp %s
+
+void f() {
+  int *p = 0;
+  // CHECK: int *p = nullptr;
+}
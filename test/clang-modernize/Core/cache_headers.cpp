@@ -0,0 +1,22 @@
+// RUN: rm -rf %t.dir %t.cache
+// RUN: mkdir -p %t.dir
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.dir/a.cpp
+// RUN: cp %S/Inputs/cache_headers_b.cpp %t.dir/b.cpp
+// RUN: grep -Ev "// *[A-Z-]+:" %S/Inputs/cache_headers.h > %t.dir/cache_headers.h
+// RUN: clang-modernize -use-nullptr -cache-dir=%t.cache -include=%t.dir %t.dir/a.cpp %t.dir/b.cpp -- -std=c++11
+// RUN: FileCheck -input-file=%t.dir/cache_headers.h %S/Inputs/cache_headers.h
+//
+// Restore the original sources and transform b.cpp alone: its cache entry
+// must hold the changes to the header shared with a.cpp.
+// RUN: cp %S/Inputs/cache_headers_b.cpp %t.dir/b.cpp
+// RUN: grep -Ev "// *[A-Z-]+:" %S/Inputs/cache_headers.h > %t.dir/cache_headers.h
+// RUN: clang-modernize -use-nullptr -summary -cache-dir=%t.cache -include=%t.dir %t.dir/b.cpp -- -std=c++11 | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -input-file=%t.dir/cache_headers.h %S/Inputs/cache_headers.h
+
+#include "cache_headers.h"
+
+void a() {
+  char *q = NULL;
+}
+
+// SUMMARY: Transform: UseNullptr - Accepted: 2
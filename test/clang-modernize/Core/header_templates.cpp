@@ -0,0 +1,17 @@
+// Test that a translation unit without changes in a header does not keep the
+// next ones from changing it: only the second translation unit instantiates
+// the template of the header.
+//
+// RUN: rm -rf %t.dir
+// RUN: mkdir -p %t.dir
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.dir/a.cpp
+// RUN: cp %S/Inputs/header_templates_b.cpp %t.dir/b.cpp
+// RUN: grep -Ev "// *[A-Z-]+:" %S/Inputs/header_templates.h > %t.dir/header_templates.h
+// RUN: clang-modernize -use-nullptr -include=%t.dir %t.dir/a.cpp %t.dir/b.cpp -- -std=c++11
+// RUN: FileCheck -input-file=%t.dir/a.cpp %s
+// RUN: FileCheck -input-file=%t.dir/header_templates.h %S/Inputs/header_templates.h
+
+#include "header_templates.h"
+
+int *a() { return 0; }
+// CHECK: int *a() { return nullptr; }
@@ -19,6 +19,37 @@
 // RUN: sed -i -e 's#\\#/#g' %T/SerializeTest/common.cpp_*.yaml
 // RUN: diff -b %T/SerializeTest/common_expected.yaml %T/SerializeTest/common.cpp_*.yaml
 //
+// The same replacements are expected when both translation units are
+// transformed in parallel.
+//
+// RUN: rm -rf %T/ParallelSerializeTest
+// RUN: mkdir -p %T/ParallelSerializeTest
+// RUN: cp %S/main.cpp %S/common.cpp %S/common.h %T/ParallelSerializeTest
+// RUN: clang-modernize -loop-convert -j 2 -serialize-replacements -serialize-dir=%T/ParallelSerializeTest -include=%T/ParallelSerializeTest %T/ParallelSerializeTest/main.cpp %T/ParallelSerializeTest/common.cpp --
+// RUN: ls -1 %T/ParallelSerializeTest | FileCheck %s --check-prefix=MAIN_CPP
+// RUN: ls -1 %T/ParallelSerializeTest | FileCheck %s --check-prefix=COMMON_CPP
+// RUN: sed -e 's#$(path)#%/T/ParallelSerializeTest#g' -e "s#\([A-Z]:/.*\.[chp]*\)#'\1'#g" %S/main_expected.yaml > %T/ParallelSerializeTest/main_expected.yaml
+// RUN: sed -i -e 's#\\#/#g' %T/ParallelSerializeTest/main.cpp_*.yaml
+// RUN: diff -b %T/ParallelSerializeTest/main_expected.yaml %T/ParallelSerializeTest/main.cpp_*.yaml
+// RUN: sed -e 's#$(path)#%/T/ParallelSerializeTest#g' -e "s#\([A-Z]:/.*\.[chp]*\)#'\1'#g" %S/common_expected.yaml > %T/ParallelSerializeTest/common_expected.yaml
+// RUN: sed -i -e 's#\\#/#g' %T/ParallelSerializeTest/common.cpp_*.yaml
+// RUN: diff -b %T/ParallelSerializeTest/common_expected.yaml %T/ParallelSerializeTest/common.cpp_*.yaml
+//
+// When changes are applied directly, the header shared by both translation
+// units is only looked at by the first one, so its loop is counted once.
+//
+// RUN: rm -rf %T/SharedHeaderTest
+// RUN: mkdir -p %T/SharedHeaderTest
+// RUN: cp %S/main.cpp %S/common.cpp %S/common.h %T/SharedHeaderTest
+// RUN: clang-modernize -loop-convert -summary -include=%T/SharedHeaderTest %T/SharedHeaderTest/main.cpp %T/SharedHeaderTest/common.cpp -- | FileCheck %s --check-prefix=SUMMARY
+// RUN: FileCheck -input-file=%T/SharedHeaderTest/common.h %s --check-prefix=HEADER
+// RUN: cp %S/common.cpp %S/common.h %T/SharedHeaderTest
+// RUN: clang-modernize -loop-convert -summary -j 2 -include=%T/SharedHeaderTest %T/SharedHeaderTest/main.cpp %T/SharedHeaderTest/common.cpp -- | FileCheck %s --check-prefix=SUMMARY
+// RUN: FileCheck -input-file=%T/SharedHeaderTest/common.h %s --check-prefix=HEADER
+//
+// SUMMARY: Transform: LoopConvert - Accepted: 2
+// HEADER: for (auto & elem : C)
+//
 // The following are for FileCheck when used on output of 'ls'. See above.
 // MAIN_CPP: {{^main.cpp_.*.yaml$}}
 // MAIN_CPP-NOT: {{main.cpp_.*.yaml}}
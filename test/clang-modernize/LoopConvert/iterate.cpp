@@ -0,0 +1,28 @@
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: clang-modernize -loop-convert -iterate=3 -summary %t.cpp -- -I %S/Inputs | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -input-file=%t.cpp %s
+//
+// Running the tool again by hand gives the same result.
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.manual.cpp
+// RUN: clang-modernize -loop-convert %t.manual.cpp -- -I %S/Inputs
+// RUN: clang-modernize -loop-convert %t.manual.cpp -- -I %S/Inputs
+// RUN: diff %t.cpp %t.manual.cpp
+
+#include "structures.h"
+
+void f() {
+  const int N = 10;
+  const int M = 15;
+  Val Nest[N][M];
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < M; ++j) {
+      printf("Got item %d", Nest[i][j].x);
+    }
+  }
+  // The inner loop is deferred by the first run and converted by the second.
+  // CHECK: for (auto & elem : Nest)
+  // CHECK-NEXT: for (auto & [[VAR:[a-zA-Z_]+]] : elem)
+  // CHECK-NEXT: printf("Got item %d", [[VAR]].x);
+}
+
+// SUMMARY: Transform: LoopConvert - Accepted: 2{{$}}
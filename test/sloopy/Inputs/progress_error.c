@@ -0,0 +1,3 @@
+int e() {
+  return Undeclared;
+}
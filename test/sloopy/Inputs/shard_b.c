@@ -0,0 +1,6 @@
+int I, J, N, M;
+
+void b() {
+  for (I = 0; I < N; I++)
+    for (J = 0; J < M; J++);
+}
@@ -0,0 +1,11 @@
+int I, N;
+int *P;
+
+void c() {
+  while (I != N) {
+    I += 2;
+  }
+  while (P) {
+    P = (int *)*P;
+  }
+}
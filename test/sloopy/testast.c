@@ -0,0 +1,8 @@
+// RUN: %clang_cc1 -emit-ast -o %t.ast %s
+// RUN: sloopy -dump-classes %t.ast -- 2>&1 | FileCheck %s
+int I, N;
+
+// CHECK: -func a -lines [[@LINE+3]],
+// CHECK: Proved: 1
+// CHECK: Stmt: WHILE
+void a() { while (I < N) { I++; } }
@@ -0,0 +1,12 @@
+// RUN: sloopy -dump-classes -max-cfg-blocks=1 %s -- 2>&1 | FileCheck %s
+// RUN: sloopy -dump-classes -max-loop-blocks=1 %s -- 2>&1 | FileCheck %s
+// RUN: sloopy -dump-classes %s -- 2>&1 | FileCheck %s -check-prefix=FULL
+int I, N;
+
+// CHECK: Degraded: 1
+// CHECK: Exits: 1
+// CHECK-NOT: Proved
+// CHECK: Stmt: WHILE
+// FULL-NOT: Degraded
+// FULL: Proved: 1
+void a() { while (I < N) { I++; } }
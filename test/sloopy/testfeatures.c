@@ -0,0 +1,17 @@
+// RUN: sloopy -features-csv=- %s -- 2>/dev/null | FileCheck %s
+int I, J, N, M;
+
+// CHECK: location,fingerprint,cfgblocks,exits,depth,SingleExitCounters,StrongSingleExitCounters,MultiExitCounters,StrongMultiExitCounters,TriviallyNonterminating,FinitePaths,ProvedWithAssumptionWrapv,ProvedWithAssumptionLeBoundNotMax,ProvedWithAssumptionGeBoundNotMin,ProvedWithAssumptionMNeq0,ProvedWithAssumptionWrapvOrRunsInto,ProvedWithAssumptionRightArrayContent,Proved,AnyExitProvedCfTerminating,
+
+// CHECK: "{{.*}}testfeatures.c -func a -lines [[@LINE+1]],",{{[0-9a-f]+}},{{[0-9]+}},1,1,{{[0-9]*,[0-9]*,[0-9]*,[0-9]*}},0,1,0,0,0,0,0,0,1,
+void a() { while (I == N) { I++; } }
+// CHECK: "{{.*}}testfeatures.c -func b -lines [[@LINE+1]],",{{[0-9a-f]+}},{{[0-9]+}},1,1,{{[0-9]*,[0-9]*,[0-9]*,[0-9]*}},0,1,0,0,0,0,1,0,1,
+void b() { while (I != N) { I++; } }
+// CHECK-DAG: "{{.*}}testfeatures.c -func c -lines [[@LINE+3]],",{{[0-9a-f]+}},{{[0-9]+}},1,1,
+// CHECK-DAG: "{{.*}}testfeatures.c -func c -lines [[@LINE+3]],",{{[0-9a-f]+}},{{[0-9]+}},1,2,
+void c() {
+  for (I = 0; I < N; I++)
+    for (J = 0; J < M; J++);
+}
+// CHECK: "{{.*}}testfeatures.c -func d -lines [[@LINE+1]],",{{[0-9a-f]+}},{{[0-9]+}},0,1,{{[0-9]*,[0-9]*,[0-9]*,[0-9]*}},1,0,,,,,,,0,
+void d() { while (1) { I++; } }
@@ -0,0 +1,33 @@
+// RUN: sloopy -dump-classes %s -- 2>&1 | FileCheck %s
+// RUN: sloopy -dump-classes -reuse-fingerprints %s -- 2>&1 | FileCheck %s -check-prefix=REUSE
+int I, J, N, M;
+
+// CHECK: Fingerprint: [[FP:[0-9a-f]+]]
+// REUSE: Fingerprint: [[FP:[0-9a-f]+]]
+// REUSE-NOT: FingerprintReused
+// REUSE: Proved: 1
+void a() { while (I < N) { I++; } }
+// CHECK: Fingerprint: [[FP]]
+// REUSE: Fingerprint: [[FP]]
+// REUSE-NEXT: FingerprintReused: 1
+// REUSE: Proved: 1
+void b() { while (J < M) { J++; } }
+// CHECK-NOT: Fingerprint: [[FP]]
+// REUSE-NOT: FingerprintReused
+void c() { while (I < N) { I--; } }
+// CHECK: Fingerprint: {{[0-9a-f]+}}
+
+// Loops differing only in literal values or pointee types don't share a
+// fingerprint.
+// CHECK: Fingerprint: [[FPF:[0-9a-f]+]]
+void d() { double X; for (X = 0; X < 1.5; X += 0.5) {} }
+// CHECK-NOT: Fingerprint: [[FPF]]
+// CHECK: Fingerprint: {{[0-9a-f]+}}
+void e() { double X; for (X = 0; X < 2.5; X += 0.5) {} }
+struct S1 { struct S1 *Next; int A; };
+struct S2 { struct S2 *Next; double B; };
+// CHECK: Fingerprint: [[FPP:[0-9a-f]+]]
+void f(struct S1 *P) { while (P) { P = P->Next; } }
+// CHECK-NOT: Fingerprint: [[FPP]]
+// CHECK: Fingerprint: {{[0-9a-f]+}}
+void g(struct S2 *Q) { while (Q) { Q = Q->Next; } }
@@ -0,0 +1,42 @@
+// RUN: sloopy -dump-classes %s -- 2>&1 | grep -v "^Time:" > %t.1
+// RUN: sloopy -dump-classes -j 4 %s -- 2>&1 | grep -v "^Time:" > %t.4
+// RUN: diff %t.1 %t.4
+// RUN: FileCheck %s < %t.4
+int I, J, N, M, C;
+
+// Functions are analyzed on -j threads, but reported in source order with
+// the same locations and classes as with -j 1.
+// CHECK: testjobs.c -func a -lines
+// CHECK: testjobs.c -func b -lines
+// CHECK: testjobs.c -func b -lines
+// CHECK: testjobs.c -func c -lines
+// CHECK: testjobs.c -func d -lines
+// CHECK: testjobs.c -func e -lines
+void a() {
+    while (I < N) {
+        I++;
+    }
+}
+void b() {
+    for (I = 0; I < N; I++) {
+        for (J = 0; J < M; J++) {
+        }
+    }
+}
+void c() {
+    while (I < N) {
+        I += 2;
+        if (C) continue;
+        I--;
+    }
+}
+void d() {
+    do {
+        I++;
+    } while (I < N);
+}
+void e() {
+    I = 0;
+l:  I++;
+    if (I < N) goto l;
+}
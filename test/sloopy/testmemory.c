@@ -0,0 +1,24 @@
+// RUN: sloopy -memory-stats=%t.csv %s --
+// RUN: FileCheck %s < %t.csv
+// RUN: sloopy -dump-classes -memory-stats=%t.csv %s -- 2>&1 | FileCheck %s -check-prefix=CLASSES
+// RUN: sloopy -dump-classes %s -- 2>&1 | FileCheck %s -check-prefix=NOSTATS
+// RUN: sloopy -ml-raw -memory-stats=%t.csv %s -- | FileCheck %s -check-prefix=ML
+// RUN: sloopy -ml-raw %s -- | FileCheck %s -check-prefix=NOML
+int I, N;
+
+// CHECK: kind,location,loops,loopallocs,loopbytes,classallocs,classbytes,z3peakkib,peakrsskib
+// CHECK-NEXT: function,"{{.*}}testmemory.c -func a",1,{{[1-9][0-9]*}},{{[1-9][0-9]*}},{{[1-9][0-9]*}},{{[1-9][0-9]*}},{{[0-9]+}},{{$}}
+// CHECK-NEXT: function,"{{.*}}testmemory.c -func b",0,0,0,0,0,0,{{$}}
+// CHECK-NEXT: tu,"{{.*}}testmemory.c",,,,,,,{{[0-9]+$}}
+// CLASSES: ClassificationAllocations: {{[1-9][0-9]*}}
+// CLASSES-NEXT: ClassificationBytes: {{[1-9][0-9]*}}
+// CLASSES: LoopAllocations: {{[1-9][0-9]*}}
+// CLASSES-NEXT: LoopBytes: {{[1-9][0-9]*}}
+// CLASSES: Z3PeakKiB: {{[0-9]+}}
+// NOSTATS-NOT: Allocations
+// NOSTATS-NOT: Bytes
+// NOSTATS-NOT: KiB
+// ML: {{( [0-9]+){15} [1-9][0-9]* [1-9][0-9]* [1-9][0-9]* [1-9][0-9]* [1-9][0-9]* [0-9]+$}}
+// NOML: {{( [0-9]+){15} 0 0 0 0 0 0$}}
+void a() { while (I < N) { I++; } }
+void b() { I = N; }
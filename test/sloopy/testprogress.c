@@ -0,0 +1,15 @@
+// RUN: not sloopy -progress -progress-interval=0 %s %S/Inputs/progress_error.c -- 2>&1 | FileCheck %s
+int I, N;
+
+// With an interval of 0, each function and TU is reported.
+// CHECK: sloopy: 0/2 TUs, 1 functions ({{[0-9.]+}}/s), 1 loops ({{[0-9.]+}}/s), elapsed {{[0-9]+:[0-9]+:[0-9]+}}, slowest {{.*}}testprogress.c -func a ({{[0-9]+}} ms), ETA ?
+// CHECK: sloopy: 1/2 TUs, 1 functions ({{[0-9.]+}}/s), 1 loops ({{[0-9.]+}}/s), elapsed {{[0-9]+:[0-9]+:[0-9]+}}, slowest {{.*}}testprogress.c -func a ({{[0-9]+}} ms), ETA {{[0-9]+:[0-9]+:[0-9]+}}
+void a() {
+  while (I < N) {
+    I++;
+  }
+}
+
+// The TU that fails to parse is dropped from the total.
+// CHECK: error: use of undeclared identifier 'Undeclared'
+// CHECK: sloopy: 1/1 TUs, {{.*}}, ETA 00:00:00
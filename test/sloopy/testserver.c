@@ -0,0 +1,14 @@
+// RUN: printf '{"id": 1, "file": "%s", "func": "a", "classes": ["Proved", "Stmt"]}\n{"id": 2, "file": "%s", "line": 10}\n{"id": "3"}\n' | sloopy -server -- | FileCheck %s
+int I, J, N, M;
+
+// CHECK: {"id": 1, "location": "{{.*}}testserver.c -func a -lines [[@LINE+3]],", "classes": {"Proved": 1, "Stmt": "WHILE"}}
+// CHECK-NEXT: {"id": 1, "loops": 1}
+// CHECK-NOT: -func b
+void a() { while (I < N) { I++; } }
+void b() {
+  for (I = 0; I < N; I++)
+    for (J = 0; J < M; J++);
+}
+// CHECK: {"id": 2, "location": "{{.*}}testserver.c -func b -lines 10,", "classes": {
+// CHECK-NEXT: {"id": 2, "loops": 1}
+// CHECK-NEXT: {"id": "3", "error": "request has no \"file\""}
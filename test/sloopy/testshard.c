@@ -0,0 +1,24 @@
+// RUN: rm -f %t.*
+// RUN: sloopy -ml -loop-stats -bench-name=%t.single %s %S/Inputs/shard_b.c %S/Inputs/shard_c.c -- > %t.single.tsv
+// RUN: sloopy -ml-raw -loop-stats -shard=0/2 -bench-name=%t.0 %s %S/Inputs/shard_b.c %S/Inputs/shard_c.c -- > %t.0.tsv
+// RUN: sloopy -ml-raw -loop-stats -shard=1/2 -bench-name=%t.1 %s %S/Inputs/shard_b.c %S/Inputs/shard_c.c -- > %t.1.tsv
+// RUN: sloopy-merge -bench-name=%t.single -o %t.merged.json %t.0.json %t.1.json %t.0.tsv %t.1.tsv > %t.merged.tsv
+//
+// The merged outputs are those of the single run, except for the times.
+// Loops are ordered by address in the JSON files, so their lines are sorted.
+// RUN: cut -f1-10 %t.single.tsv > %t.single.counts
+// RUN: cut -f1-10 %t.merged.tsv > %t.merged.counts
+// RUN: diff %t.single.counts %t.merged.counts
+// RUN: grep -v '"Time"' %t.single.json | sort > %t.single.classes
+// RUN: grep -v '"Time"' %t.merged.json | sort > %t.merged.classes
+// RUN: diff %t.single.classes %t.merged.classes
+// RUN: FileCheck %s < %t.merged.classes
+int I, N;
+
+// Each shard analyzes some of the loops.
+// CHECK-DAG: "Location": "{{.*}}testshard.c -func a -lines
+// CHECK-DAG: "Location": "{{.*}}Inputs/shard_b.c -func b -lines
+// CHECK-DAG: "Location": "{{.*}}Inputs/shard_b.c -func b -lines
+// CHECK-DAG: "Location": "{{.*}}Inputs/shard_c.c -func c -lines
+// CHECK-DAG: "Location": "{{.*}}Inputs/shard_c.c -func c -lines
+void a() { while (I < N) { I++; } }
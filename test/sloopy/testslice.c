@@ -0,0 +1,20 @@
+// RUN: sloopy -dump-classes %s -- 2>&1 | FileCheck %s
+int I, N, X, M, C;
+
+// The increment of I is control dependent on X++ < M, which defines X. The
+// condition is tracked as a control dependence before it is seen as the
+// definition of X, so the fixed point does not follow it to if (C): the
+// slices track I, N, X and M only.
+// CHECK: AllLoops:
+// CHECK-NEXT: ControlVars: 4
+// CHECK: OuterLoop:
+// CHECK-NEXT: ControlVars: 4
+void a() {
+    while (I < N) {
+        if (C) {
+            if (X++ < M) {
+                I++;
+            }
+        }
+    }
+}
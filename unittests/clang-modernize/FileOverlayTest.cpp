@@ -0,0 +1,57 @@
+//===- unittests/clang-modernize/FileOverlayTest.cpp ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "Core/FileOverlay.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/system_error.h"
+
+using namespace llvm;
+using namespace llvm::sys;
+
+TEST(FileOverlay, makeCanonical) {
+  SmallString<128> TmpDir;
+  path::system_temp_directory(true, TmpDir);
+
+  SmallString<128> Expected(TmpDir);
+  path::append(Expected, "project", "header.h");
+
+  SmallString<128> Path(TmpDir);
+  path::append(Path, "project", "lib", "..");
+  path::append(Path, ".", "header.h");
+  FileOverlay::makeCanonical(Path);
+  EXPECT_EQ(Expected.str(), Path.str());
+
+  SmallString<128> Current;
+  ASSERT_FALSE(fs::current_path(Current));
+  SmallString<128> Relative("header.h");
+  FileOverlay::makeCanonical(Relative);
+  path::append(Current, "header.h");
+  EXPECT_EQ(Current.str(), Relative.str());
+}
+
+TEST(FileOverlay, containsNormalizesPath) {
+  SmallString<128> TmpDir;
+  path::system_temp_directory(true, TmpDir);
+
+  SmallString<128> Key(TmpDir);
+  path::append(Key, "project", "header.h");
+  FileOverlay Overlay;
+  Overlay.getFiles()[Key.str()] = "int i;\n";
+
+  SmallString<128> Path(TmpDir);
+  path::append(Path, "project", "include", "..", "header.h");
+  EXPECT_TRUE(Overlay.contains(Path));
+
+  SmallString<128> Other(TmpDir);
+  path::append(Other, "project", "include", "header.h");
+  EXPECT_FALSE(Overlay.contains(Other));
+}
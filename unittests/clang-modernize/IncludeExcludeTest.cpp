@@ -76,6 +76,32 @@ TEST(IncludeExcludeTest, ParseStringCases) {
   EXPECT_FALSE(IEManager.isFileIncluded("c/c2/c3/f.cpp"));
 }
 
+TEST(IncludeExcludeTest, NestedPaths) {
+  IncludeExcludeInfo IEManager;
+  llvm::error_code Err = IEManager.readListFromString(
+      /*include=*/ "n/n2/n3,n,m/m2",
+      /*exclude=*/ "n/x,n/n2/x/x2");
+
+  ASSERT_EQ(Err, llvm::error_code::success());
+
+  // Paths only match whole components.
+  EXPECT_FALSE(IEManager.isFileIncluded("nn/f.cpp"));
+  EXPECT_FALSE(IEManager.isFileIncluded("m/m22/f.cpp"));
+  EXPECT_FALSE(IEManager.isFileIncluded("m/f.cpp"));
+
+  // The shortest included prefix is enough.
+  EXPECT_TRUE(IEManager.isFileIncluded("n/f.cpp"));
+  EXPECT_TRUE(IEManager.isFileIncluded("n/n2/f.cpp"));
+  EXPECT_TRUE(IEManager.isFileIncluded("n/n2/n3/f.cpp"));
+  EXPECT_TRUE(IEManager.isFileIncluded("m/m2/f.cpp"));
+
+  EXPECT_FALSE(IEManager.isFileIncluded("n/x/f.cpp"));
+  EXPECT_FALSE(IEManager.isFileIncluded("n/n2/x/x2/f.cpp"));
+  EXPECT_TRUE(IEManager.isFileIncluded("n/n2/x/f.cpp"));
+  EXPECT_TRUE(IEManager.isFileExplicitlyExcluded("n/x/f.cpp"));
+  EXPECT_FALSE(IEManager.isFileExplicitlyExcluded("n/n2/f.cpp"));
+}
+
 // Utility for creating and filling files with data for IncludeExcludeFileTest
 // tests.
 struct InputFiles {
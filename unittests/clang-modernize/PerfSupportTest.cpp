@@ -95,3 +95,61 @@ TEST(PerfSupport, collectSourcePerfData) {
   EXPECT_EQ("TransformB", FileBI->second[0].Label);
   EXPECT_LE(FileCI->second[1].Duration, FileBI->second[0].Duration);
 }
+
+TEST(PerfSupport, writeProfileSummary) {
+  ProfileData Data;
+  for (unsigned I = 1; I <= 100; ++I) {
+    ProfileData::SourceEntry Entry;
+    Entry.Transform = "TransformA";
+    Entry.Source = "File.cpp";
+    Entry.Profile.Callbacks = I / 1000.0;
+    Data.Sources.push_back(Entry);
+  }
+  Data.Callbacks["TransformA"]["Matcher"].Count = 4;
+  Data.Callbacks["TransformA"]["Matcher"].WallTime = 0.002;
+
+  std::string Summary;
+  raw_string_ostream OS(Summary);
+  writeProfileSummary(OS, Data);
+  OS.flush();
+
+  EXPECT_NE(std::string::npos, Summary.find("TransformA: 100 sources"));
+  // Nearest-rank p50, p90, p99, max and total of 1ms to 100ms.
+  EXPECT_NE(std::string::npos,
+            Summary.find("Callbacks          50.00       90.00       99.00"
+                         "      100.00     5050.00"));
+  EXPECT_NE(std::string::npos,
+            Summary.find("Matcher                            4        2.00"
+                         "      500.00"));
+}
+
+TEST(PerfSupport, writeChromeTrace) {
+  ProfileData Data;
+  ProfileData::SourceEntry Entry;
+  Entry.Transform = "TransformA";
+  Entry.Source = "C:\\File.cpp";
+  Entry.Profile.Start = 10.0;
+  Data.Sources.push_back(Entry);
+  ProfileData::PhaseEntry Phase;
+  Phase.Transform = "TransformA";
+  Phase.Name = "Apply";
+  Phase.Start = 11.0;
+  Data.Phases.push_back(Phase);
+
+  std::string Trace;
+  raw_string_ostream OS(Trace);
+  writeChromeTrace(OS, Data);
+  OS.flush();
+
+  EXPECT_NE(std::string::npos, Trace.find("\"traceEvents\""));
+  EXPECT_NE(std::string::npos,
+            Trace.find("{ \"name\" : \"C:\\\\File.cpp\", \"cat\" : "
+                       "\"TransformA\", \"ph\" : \"X\", \"ts\" : 0, "
+                       "\"dur\" : 0, \"pid\" : 1, \"tid\" : 0 }"));
+  EXPECT_NE(std::string::npos, Trace.find("\"name\" : \"Parse\""));
+  EXPECT_NE(std::string::npos, Trace.find("\"name\" : \"Match\""));
+  EXPECT_NE(std::string::npos,
+            Trace.find("{ \"name\" : \"Apply\", \"cat\" : \"TransformA\", "
+                       "\"ph\" : \"X\", \"ts\" : 1000000, \"dur\" : 0, "
+                       "\"pid\" : 1, \"tid\" : 0 }"));
+}
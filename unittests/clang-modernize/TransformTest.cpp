@@ -38,6 +38,14 @@ public:
     Transform::setDeferredChanges(Changes);
   }
 
+  MatchFinder::MatchCallback *profileCallback(MatchFinder::MatchCallback *C,
+                                              StringRef Label) {
+    return Transform::profileCallback(C, Label);
+  }
+
+  tooling::FrontendActionFactory *createActionFactory(MatchFinder &Finder) {
+    return Transform::createActionFactory(Finder);
+  }
 };
 
 TEST(Transform, Interface) {
@@ -177,6 +185,56 @@ TEST(Transform, Timings) {
   EXPECT_EQ(T.timing_end(), I);
 }
 
+class CountingCallback : public MatchFinder::MatchCallback {
+public:
+  CountingCallback() : Count(0) {}
+
+  virtual void run(const MatchFinder::MatchResult &) { ++Count; }
+
+  unsigned Count;
+};
+
+TEST(Transform, Profiles) {
+  TransformOptions Options;
+  Options.EnableTiming = true;
+  Options.SkipTransformedHeaders = false;
+  DummyTransform T("profile_transform", Options);
+
+  SmallString<128> CurrentDir;
+  llvm::error_code EC = llvm::sys::fs::current_path(CurrentDir);
+  assert(!EC);
+  (void)EC;
+
+  SmallString<128> FileA = CurrentDir;
+  llvm::sys::path::append(FileA, "a.cc");
+
+  tooling::FixedCompilationDatabase Compilations(CurrentDir.str(),
+                                                 std::vector<std::string>());
+  tooling::ClangTool Tool(Compilations,
+                          std::vector<std::string>(1, FileA.str()));
+  Tool.mapVirtualFile(FileA, "int a; int b;");
+
+  CountingCallback Callback;
+  MatchFinder Finder;
+  Finder.addMatcher(varDecl(), T.profileCallback(&Callback, "VarDecl"));
+  Tool.run(T.createActionFactory(Finder));
+
+  // Callbacks still run, and every run is counted.
+  EXPECT_EQ(2u, Callback.Count);
+  ASSERT_EQ(1u, T.getCallbackProfiles().size());
+  EXPECT_EQ(2u, T.getCallbackProfiles().lookup("VarDecl").Count);
+
+  Transform::ProfileVec::const_iterator I = T.profile_begin();
+  ASSERT_NE(T.profile_end(), I);
+  EXPECT_EQ(FileA, I->first);
+  EXPECT_GE(I->second.Parse.getWallTime(), 0.0);
+  EXPECT_GE(I->second.Matching.getWallTime(), I->second.Callbacks);
+  EXPECT_GE(I->second.Callbacks, 0.0);
+  EXPECT_GT(I->second.Start, 0.0);
+  ++I;
+  EXPECT_EQ(T.profile_end(), I);
+}
+
 class ModifiableCallback
     : public clang::ast_matchers::MatchFinder::MatchCallback {
 public: